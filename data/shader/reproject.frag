@@ -0,0 +1,10 @@
+#version 130
+
+in float dist;
+
+void main(void)
+{
+    // blended with GL_MIN into a target cleared to (huge, 0): x is the
+    // nearest point, y < 0 marks pixels that received any point
+    gl_FragColor = vec4(dist, -1., 0., 0.);
+}
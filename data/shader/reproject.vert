@@ -0,0 +1,50 @@
+#version 130
+
+// Splats the end points of the previous frame's rays into the current view,
+// one point per texel of hitTex, whose index is gl_VertexID.
+
+uniform sampler2D hitTex;
+
+uniform float screenWidth;
+uniform float screenHeight;
+uniform float stepX;
+uniform float stepY;
+
+uniform vec3 prevCameraPos;
+uniform vec3 prevCameraUp;
+uniform vec3 prevCameraDir;
+
+uniform vec3 cameraPos;
+uniform vec3 cameraUp;
+uniform vec3 cameraDir;
+
+out float dist;
+
+void main()
+{
+    int width = int(screenWidth);
+    ivec2 pixel = ivec2(gl_VertexID % width, gl_VertexID / width);
+    float t = texelFetch(hitTex, pixel, 0).x;
+
+    // getRay() of shader.frag with the previous camera
+    vec2 screen = vec2(pixel) + 0.5;
+    vec3 d = normalize(  prevCameraDir
+                       + cross(prevCameraDir, prevCameraUp) * ((screen.x - screenWidth/2.) * stepX)
+                       + prevCameraUp * ((screen.y - screenHeight/2.) * stepY));
+    vec3 v = prevCameraPos + t*d - cameraPos;
+
+    // dir and up need not be orthogonal: solve v = k*(dir + a*right + b*up)
+    // for the screen offsets a and b with Cramer's rule
+    vec3 right = cross(cameraDir, cameraUp);
+    vec3 rowZ = cross(right, cameraUp);
+    float z = dot(v, rowZ);
+    vec2 offset = vec2(dot(v, cross(cameraUp, cameraDir)), dot(v, cross(cameraDir, right))) / z / vec2(stepX, stepY);
+
+    dist = length(v);
+
+    // 2 pixels wide: covers the four pixels whose centres surround the
+    // point, which closes the gaps between points where the view magnifies.
+    // Points behind the camera get w = -1 and are clipped.
+    gl_PointSize = 2.;
+    gl_Position = vec4(offset / vec2(screenWidth/2., screenHeight/2.), 0., z * dot(cameraDir, rowZ) > 0. ? 1. : -1.);
+}
@@ -13,13 +13,69 @@ uniform float stepY;
 
 uniform sampler3D worldTex;
 uniform ivec3 worldSize;
-
-void getRay(out vec3 rayOrigin, out vec3 rayDir, in vec2 delta)
+uniform float worldScale;
+
+// sparse world: page table and atlas of surface bricks
+uniform bool sparseWorld;
+uniform sampler3D pageTex;
+uniform sampler3D atlasTex;
+uniform ivec3 atlasSlots;
+
+// min-distance pyramid: level l of the pyramid is mip level l-1
+uniform bool hierarchical;
+uniform sampler3D pyramidTex;
+uniform int pyramidLevels;
+
+// over-relaxation factor for sphere tracing, 1 = plain sphere tracing
+uniform float relaxation;
+
+// cone marching prepass: with conePass set, one fragment per block of
+// prepassScale x prepassScale pixels writes the start distance of the
+// block, which the full resolution pass reads from prepassTex
+uniform bool conePass;
+uniform bool usePrepass;
+uniform int prepassScale;
+uniform sampler2D prepassTex;
+
+// temporal reprojection: reprojTex holds the nearest end point of the
+// previous frame's rays splatted into this view (x), and y < 0 where any
+// point landed. The hit distance of this frame goes to gl_FragData[1].
+uniform bool useReprojection;
+uniform sampler2D reprojTex;
+uniform float reprojectionBackoff;
+
+// normals from the analytic gradient of the B-spline, or from central
+// differences of distToScene()
+uniform bool analyticNormals;
+
+// baked shading: shadingTex holds the normal (rgb, encoded as n*0.5 + 0.5)
+// and the detail term of the terrain colour (a) per voxel
+uniform bool bakedShading;
+uniform sampler3D shadingTex;
+
+// height map: heightTex holds an upper bound of the terrain per tile of
+// heightTileSize (normalized); rising rays above heightTop leave it
+uniform bool useHeightMap;
+uniform sampler2D heightTex;
+uniform vec2 heightTileSize;
+uniform float heightTop;
+
+// step heatmap: march loop iterations (pyramid lookups, height map skips
+// and distance samples) and distance samples of each pixel go to
+// gl_FragData[2]; with stepHeatmap set, the pixel shows the iterations in
+// false colour, red at heatmapMax
+uniform bool stepHeatmap;
+uniform float heatmapMax;
+
+const int BRICK = 8;
+const int SLOT = BRICK + 1;
+
+void getRay(out vec3 rayOrigin, out vec3 rayDir, in vec2 pixel)
 {
     rayOrigin = cameraPos;
     rayDir =   cameraDir
-             + cross(cameraDir, cameraUp) * ((screenPos.x - screenWidth/2.) * stepX + delta.x * stepX)
-             + cameraUp * ((screenPos.y - screenHeight/2.) * stepY + delta.y * stepY); 
+             + cross(cameraDir, cameraUp) * ((pixel.x - screenWidth/2.) * stepX)
+             + cameraUp * ((pixel.y - screenHeight/2.) * stepY); 
     rayDir = normalize(rayDir);
 }
 
@@ -32,6 +88,39 @@ mat4 bspCoeffs = 1./6.*mat4(-1, 3,-3, 1,
                       -3, 3, 3, 1,
                        1, 0, 0, 0);
 
+// GL_LINEAR lookup in the sparse world, with the wrap modes of worldTex.
+// Page table texels are (atlas slot or -1, distance for bricks without slot).
+float sparseTexture(vec3 pos)
+{
+    vec3 size = vec3(worldSize);
+    pos.xz = 1. - abs(mod(pos.xz, 2.) - 1.);
+    vec3 p = clamp(pos * size, vec3(0.5), size - 0.5);
+
+    ivec3 brick = ivec3(floor(p - 0.5)) / BRICK;
+    vec2 page = texelFetch(pageTex, brick, 0).xy;
+    if(page.x < 0.)
+        return page.y;
+
+    int slot = int(page.x);
+    ivec3 slotPos = ivec3(slot % atlasSlots.x, slot / atlasSlots.x % atlasSlots.y, slot / (atlasSlots.x * atlasSlots.y));
+    vec3 atlasPos = vec3(slotPos * SLOT - brick * BRICK) + p;
+    return texture(atlasTex, atlasPos / vec3(atlasSlots * SLOT)).x;
+}
+
+// GL_MIRRORED_REPEAT for texel indices
+int mirrorIndex(int i, int n)
+{
+    int m = i - 2*n * int(floor(float(i) / float(2*n)));
+    return m < n ? m : 2*n - 1 - m;
+}
+
+float worldTexture(sampler3D tex, vec3 pos)
+{
+    if(sparseWorld)
+        return sparseTexture(pos);
+    return texture(tex, pos).x;
+}
+
 float bspline_2d_fp(sampler3D tex, vec3 pos, ivec3 texSize)
 {
     pos *= texSize;
@@ -65,14 +154,14 @@ float bspline_2d_fp(sampler3D tex, vec3 pos, ivec3 texSize)
     t0 /= texSize;
     t1 /= texSize;
 
-    float p000 = texture(tex, vec3(t0.x, t0.y, t0.z)).x;
-    float p001 = texture(tex, vec3(t0.x, t0.y, t1.z)).x;
-    float p010 = texture(tex, vec3(t0.x, t1.y, t0.z)).x;
-    float p011 = texture(tex, vec3(t0.x, t1.y, t1.z)).x;
-    float p100 = texture(tex, vec3(t1.x, t0.y, t0.z)).x;
-    float p101 = texture(tex, vec3(t1.x, t0.y, t1.z)).x;
-    float p110 = texture(tex, vec3(t1.x, t1.y, t0.z)).x;
-    float p111 = texture(tex, vec3(t1.x, t1.y, t1.z)).x;
+    float p000 = worldTexture(tex, vec3(t0.x, t0.y, t0.z));
+    float p001 = worldTexture(tex, vec3(t0.x, t0.y, t1.z));
+    float p010 = worldTexture(tex, vec3(t0.x, t1.y, t0.z));
+    float p011 = worldTexture(tex, vec3(t0.x, t1.y, t1.z));
+    float p100 = worldTexture(tex, vec3(t1.x, t0.y, t0.z));
+    float p101 = worldTexture(tex, vec3(t1.x, t0.y, t1.z));
+    float p110 = worldTexture(tex, vec3(t1.x, t1.y, t0.z));
+    float p111 = worldTexture(tex, vec3(t1.x, t1.y, t1.z));
 
     float a = mix(p000, p100, s1.x);
     float b = mix(p010, p110, s1.x);
@@ -85,9 +174,64 @@ float bspline_2d_fp(sampler3D tex, vec3 pos, ivec3 texSize)
     return mix(ab, cd, s1.z);
 }
 
+// Sum of the 8 trilinear lookups at the combinations of x, y and z, the
+// corner (i, j, k) weighted with wx[i]*wy[j]*wz[k]. Coordinates in texels.
+float sumTrilinear(sampler3D tex, vec2 x, vec2 y, vec2 z, vec2 wx, vec2 wy, vec2 wz, vec3 texSize)
+{
+    x /= texSize.x;
+    y /= texSize.y;
+    z /= texSize.z;
+    return wz.x * (wy.x * (wx.x * worldTexture(tex, vec3(x.x, y.x, z.x)) + wx.y * worldTexture(tex, vec3(x.y, y.x, z.x)))
+                 + wy.y * (wx.x * worldTexture(tex, vec3(x.x, y.y, z.x)) + wx.y * worldTexture(tex, vec3(x.y, y.y, z.x))))
+         + wz.y * (wy.x * (wx.x * worldTexture(tex, vec3(x.x, y.x, z.y)) + wx.y * worldTexture(tex, vec3(x.y, y.x, z.y)))
+                 + wy.y * (wx.x * worldTexture(tex, vec3(x.x, y.y, z.y)) + wx.y * worldTexture(tex, vec3(x.y, y.y, z.y))));
+}
+
+// bspline_2d_fp() together with its gradient with respect to pos. The
+// derivative of the cubic B-spline splits into two linear lookups like the
+// spline itself, with weights -g and g, so each gradient component takes 8
+// lookups that only differ from those of the value along its own axis:
+// 32 lookups instead of 48 for central differences.
+float bspline_2d_fp_grad(sampler3D tex, vec3 pos, ivec3 texSize, out vec3 gradient)
+{
+    vec3 size = vec3(texSize);
+    pos *= size;
+    vec3 tc = floor(pos - 0.5) + 0.5;
+
+    vec3 alpha = pos - tc;
+    vec3 alpha2 = alpha*alpha;
+    vec3 alpha3 = alpha2*alpha;
+    vec3 w0 = 1./6. * (-alpha3 + 3.*alpha2 - 3.*alpha + 1.);
+    vec3 w1 = 1./6. * (3.*alpha3 - 6.*alpha2 + 4.);
+    vec3 w2 = 1./6. * (-3.*alpha3 + 3.*alpha2 + 3.*alpha + 1.);
+    vec3 w3 = 1./6. * alpha3;
+
+    // derivatives of the weights; dw0, dw1 <= 0 and dw2, dw3 >= 0
+    vec3 dw0 = 0.5 * (-alpha2 + 2.*alpha - 1.);
+    vec3 dw1 = 0.5 * (3.*alpha2 - 4.*alpha);
+    vec3 dw2 = 0.5 * (-3.*alpha2 + 2.*alpha + 1.);
+    vec3 dw3 = 0.5 * alpha2;
+
+    vec3 s1 = w2 + w3;
+    vec3 t0 = tc - 1. + w1 / (w0 + w1);
+    vec3 t1 = tc + 1. + w3 / (w2 + w3);
+
+    vec3 g = (dw2 + dw3) * size;
+    vec3 dt0 = tc - 1. + dw1 / (dw0 + dw1);
+    vec3 dt1 = tc + 1. + dw3 / (dw2 + dw3);
+
+    vec2 sx = vec2(1. - s1.x, s1.x), sy = vec2(1. - s1.y, s1.y), sz = vec2(1. - s1.z, s1.z);
+    vec2 tx = vec2(t0.x, t1.x), ty = vec2(t0.y, t1.y), tz = vec2(t0.z, t1.z);
+
+    gradient = vec3(sumTrilinear(tex, vec2(dt0.x, dt1.x), ty, tz, vec2(-g.x, g.x), sy, sz, size),
+                    sumTrilinear(tex, tx, vec2(dt0.y, dt1.y), tz, sx, vec2(-g.y, g.y), sz, size),
+                    sumTrilinear(tex, tx, ty, vec2(dt0.z, dt1.z), sx, sy, vec2(-g.z, g.z), size));
+    return sumTrilinear(tex, tx, ty, tz, sx, sy, sz, size);
+}
+
 float distToScene(vec3 pos)
 {
-    return bspline_2d_fp(worldTex, pos.xyz, worldSize);
+    return bspline_2d_fp(worldTex, pos.xyz, worldSize) * worldScale;
 }
 
 float rand2(vec3 n)
@@ -135,23 +279,39 @@ float rand(vec3 n, float dist)
     return 3. * ((c * 0.5) + 0.5);
 }
 
-vec3 sceneColor(vec3 pos, vec3 n, float dist)
+vec3 terrainColor(vec3 n, float intensity)
 {
     vec3 green = vec3(0.27, 0.42, 0.19);
     vec3 gray = vec3(0.2, 0.2, 0.19);
-    float intensity = rand(pos, dist);
-
-    vec3 color = vec3(intensity,intensity,intensity);
 
     float grayness = exp(-dot(n,vec3(0,1,0))/0.9);
 
-    color = mix(green, gray, min(1.,grayness)) * intensity;
+    return mix(green, gray, min(1.,grayness)) * intensity;
+}
+
+vec3 sceneColor(vec3 pos, vec3 n, float dist)
+{
+    return terrainColor(n, rand(pos, dist));
+}
 
-    return color;
+// Normal from a shadingTex texel at pos. The texture repeats mirrored along
+// x and z, so the normal is mirrored in every other repetition.
+vec3 shadingNormal(vec4 texel, vec3 pos)
+{
+    vec3 n = texel.xyz * 2. - 1.;
+    n.xz *= 1. - 2. * mod(floor(pos.xz), 2.);
+    return normalize(n);
 }
 
 vec3 normal(vec3 pos)
 {
+    if(analyticNormals)
+    {
+        vec3 gradient;
+        bspline_2d_fp_grad(worldTex, pos, worldSize, gradient);
+        return normalize(gradient);
+    }
+
     float eps_x = 1./float(worldSize.x);
     float eps_y = 1./float(worldSize.y);
     float eps_z = 1./float(worldSize.z);
@@ -162,6 +322,80 @@ vec3 normal(vec3 pos)
     return t;
 }
 
+// Marches a cone around the ray whose radius grows by spread per unit of t
+// and returns how far all rays inside it can start. Steps by the distance
+// minus the cone radius and stops where the cone nearly touches a surface.
+float coneMarch(vec3 o, vec3 d, float spread, float maxT)
+{
+    float t = 0.;
+    while(t < maxT)
+    {
+        vec3 p = o + t*d;
+        if(p.y > 1. && d.y > 0.)
+            break;
+        float advance = distToScene(p) - spread * t;
+        if(advance <= 0.003*t)
+            break;
+        t += advance;
+    }
+    return min(t, maxT);
+}
+
+// Where the ray o + t*d, at t, can continue: t itself below the bound of
+// its tile, else where it leaves the space above the tile. Mirrors
+// HeightMap::skip().
+float heightSkip(vec3 o, vec3 d, float t, float maxT)
+{
+    vec3 p = o + t*d;
+    if(p.y > heightTop && d.y > 0.)
+        return maxT;
+
+    vec2 cell = floor(p.xz / heightTileSize);
+    ivec2 size = textureSize(heightTex, 0);
+    float h = texelFetch(heightTex, ivec2(mirrorIndex(int(cell.x), size.x), mirrorIndex(int(cell.y), size.y)), 0).x;
+    if(p.y <= h)
+        return t;
+
+    vec2 face = (cell + step(0., d.xz)) * heightTileSize;
+    vec2 tFace = mix(vec2(maxT), (face - o.xz) / d.xz, notEqual(d.xz, vec2(0.)));
+    float exit = min(tFace.x, tFace.y);
+    if(d.y < 0.)
+        exit = min(exit, (h - o.y) / d.y);
+    return max(exit, t) + 1e-5;
+}
+
+// Start distance from the previous frame: a backed-off fraction of the
+// nearest reprojected point around the pixel, or 0 where the neighbourhood
+// has a hole or the start point is inside the surface (disocclusion).
+float reprojectedStart(vec3 o, vec3 d)
+{
+    // the frame may only cover part of the texture
+    ivec2 size = ivec2(screenWidth, screenHeight);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float nearest = 1e30;
+    for(int y=-1; y<=1; ++y)
+    {
+        for(int x=-1; x<=1; ++x)
+        {
+            vec2 n = texelFetch(reprojTex, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).xy;
+            if(n.y >= 0.)
+                return 0.;
+            nearest = min(nearest, n.x);
+        }
+    }
+    float t = nearest * reprojectionBackoff;
+    return distToScene(o + t*d) > 0. ? t : 0.;
+}
+
+// blue through green to red, white above 1; heatmapColor() in StepStats.cpp
+vec3 heatmapColor(float x)
+{
+    if(x > 1.)
+        return vec3(1.);
+    x = max(x, 0.);
+    return clamp(vec3(1.5) - abs(4.*vec3(x) - vec3(3., 2., 1.)), 0., 1.);
+}
+
 vec3 fog(vec3 color, float dist, float maxDist, vec3 fogColor)
 {
     float amount = exp(-dist/maxDist*10.);
@@ -170,6 +404,17 @@ vec3 fog(vec3 color, float dist, float maxDist, vec3 fogColor)
 
 void main(void)
 {
+    if(conePass)
+    {
+        // the cone through the block centre contains the rays of all pixel
+        // centres of the block
+        vec3 o, d;
+        getRay(o, d, gl_FragCoord.xy * float(prepassScale));
+        float spread = 0.5 * float(prepassScale) * length(vec2(stepX, stepY));
+        gl_FragData[0] = vec4(coneMarch(o, d, spread, 6.), 0., 0., 1.);
+        return;
+    }
+
     vec3 lightDir = vec3(0,1,1);
     lightDir = normalize(lightDir);
 
@@ -180,28 +425,99 @@ void main(void)
     bool hit = false;
 
     vec3 o, d;
-    getRay(o, d, vec2(0,0));
+    getRay(o, d, screenPos);
 
     float maxT = 6.;
-    float t = 0.;
+    float t = usePrepass ? texelFetch(prepassTex, ivec2(gl_FragCoord.xy) / prepassScale, 0).x : 0.;
+    if(useReprojection)
+        t = max(t, reprojectedStart(o, d));
+    int level = hierarchical ? pyramidLevels : 0;
+
+    // over-relaxed stepping: once consecutive unbounding spheres stop
+    // overlapping, undo the last step and continue without relaxation
+    float omega = relaxation;
+    float stepLength = 0.;
+    float prevRadius = 0.;
+
+    int iterations = 0;
+    int samples = 0;
 
     while(t < maxT)
     {
         vec3 p = o + t*d;
         if(p.y > 1. && d.y > 0.)
             break;
+        ++iterations;
+
+        if(useHeightMap)
+        {
+            float skipT = min(heightSkip(o, d, t, maxT), maxT);
+            if(skipT > t)
+            {
+                t = skipT;
+                stepLength = prevRadius = 0.;
+                continue;
+            }
+        }
+
+        if(level > 0)
+        {
+            // skip cells that contain no surface, descend into the others
+            vec3 cellSize = float(1 << level) / vec3(worldSize);
+            vec3 cell = floor(p / cellSize);
+            ivec3 levelSize = textureSize(pyramidTex, level - 1);
+            ivec3 c = ivec3(mirrorIndex(int(cell.x), levelSize.x),
+                            clamp(int(cell.y), 0, levelSize.y - 1),
+                            mirrorIndex(int(cell.z), levelSize.z));
+            float bound = texelFetch(pyramidTex, c, level - 1).x;
+
+            if(bound > 0.)
+            {
+                vec3 face = (cell + step(0., d)) * cellSize;
+                vec3 tFace = mix(vec3(maxT), (face - o) / d, notEqual(d, vec3(0.)));
+                float exit = min(min(tFace.x, tFace.y), tFace.z);
+                t = max(exit + 1e-5, t + bound);
+                level = min(level + 1, pyramidLevels);
+                stepLength = prevRadius = 0.;
+            }
+            else
+            {
+                --level;
+            }
+            continue;
+        }
+
         float dist = distToScene(p);
-        if(dist > 0.)
+        ++samples;
+        if(omega > 1. && abs(dist) + prevRadius < stepLength)
         {
-            t += max(dist, 0.003*t);
+            stepLength -= omega * stepLength;
+            omega = 1.;
+        }
+        else if(dist > 0.)
+        {
+            stepLength = max(dist, 0.003*t) * omega;
+            if(hierarchical && dist * float(worldSize.x) >= 2.)
+                level = 1;
         }
         else
         {
-            vec3 n = normal(p);
-            color = max(0.3,dot(n, lightDir)) * sceneColor(p, n, t);
+            if(bakedShading)
+            {
+                vec4 texel = texture(shadingTex, p);
+                vec3 n = shadingNormal(texel, p);
+                color = max(0.3,dot(n, lightDir)) * terrainColor(n, 3. * ((texel.w * 0.5) + 0.5));
+            }
+            else
+            {
+                vec3 n = normal(p);
+                color = max(0.3,dot(n, lightDir)) * sceneColor(p, n, t);
+            }
             hit = true;
             break;
         }
+        prevRadius = abs(dist);
+        t += stepLength;
     }
     color = fog(color, t, maxT, skyColor);
 
@@ -213,5 +529,10 @@ void main(void)
         color = mix(skyColor, sunColor*1.3, a);
     }
 
-    gl_FragColor = vec4(color, 1.);
+    if(stepHeatmap)
+        color = heatmapColor(float(iterations) / heatmapMax);
+
+    gl_FragData[0] = vec4(color, 1.);
+    gl_FragData[1] = vec4(t, 0., 0., 1.);
+    gl_FragData[2] = vec4(float(iterations), float(samples), 0., 1.);
 }
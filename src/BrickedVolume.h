@@ -0,0 +1,98 @@
+#ifndef BRICKEDVOLUME_H_
+#define BRICKEDVOLUME_H_
+
+#include <vector>
+#include <stddef.h>
+#include "Vector.h"
+
+// Volume stored as BRICK^3 bricks, each brick contiguous in memory, so that
+// neighbours in y and z are usually in the same brick instead of a row or a
+// slice away. Dimensions are padded to whole bricks.
+template<class T, int BRICK = 8>
+struct BrickedVolume
+{
+    BrickedVolume(int w, int h, int d)
+        : width(w), height(h), depth(d),
+          bricksX((w+BRICK-1)/BRICK), bricksY((h+BRICK-1)/BRICK), bricksZ((d+BRICK-1)/BRICK),
+          data((size_t)bricksX*bricksY*bricksZ*BRICK*BRICK*BRICK)
+    {}
+
+    int width;
+    int height;
+    int depth;
+
+    int bricksX;
+    int bricksY;
+    int bricksZ;
+
+    size_t index(int x, int y, int z) const
+    {
+        unsigned int ux = x, uy = y, uz = z;
+        size_t brick = ((size_t)(uz / BRICK)*bricksY + uy / BRICK)*bricksX + ux / BRICK;
+        return brick*BRICK*BRICK*BRICK + ((uz % BRICK)*BRICK + uy % BRICK)*BRICK + ux % BRICK;
+    }
+
+    T at(int x, int y, int z) const
+    {
+        return data[index(x, y, z)];
+    }
+
+    T at(const Vec3i& pos) const
+    {
+        return at(pos[0], pos[1], pos[2]);
+    }
+
+    T& at(int x, int y, int z)
+    {
+        return data[index(x, y, z)];
+    }
+
+    T& at(const Vec3i& pos)
+    {
+        return at(pos[0], pos[1], pos[2]);
+    }
+
+    std::vector<T> data;
+};
+
+typedef BrickedVolume<float> BrickedDistanceField;
+
+// Copies a volume in linear z*width*height + y*width + x layout into bricks.
+template<class T, int BRICK>
+void toBricked(const T* linear, BrickedVolume<T, BRICK>& bricked)
+{
+    int w = bricked.width, h = bricked.height, d = bricked.depth;
+
+#pragma omp parallel for
+    for(int z=0; z<d; ++z)
+    {
+        for(int y=0; y<h; ++y)
+        {
+            for(int x=0; x<w; ++x)
+            {
+                bricked.at(x, y, z) = linear[(size_t)z*w*h + y*w + x];
+            }
+        }
+    }
+}
+
+// Copies the bricks back into linear layout, e.g. for the texture upload.
+template<class T, int BRICK>
+void toLinear(const BrickedVolume<T, BRICK>& bricked, T* linear)
+{
+    int w = bricked.width, h = bricked.height, d = bricked.depth;
+
+#pragma omp parallel for
+    for(int z=0; z<d; ++z)
+    {
+        for(int y=0; y<h; ++y)
+        {
+            for(int x=0; x<w; ++x)
+            {
+                linear[(size_t)z*w*h + y*w + x] = bricked.at(x, y, z);
+            }
+        }
+    }
+}
+
+#endif
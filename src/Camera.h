@@ -0,0 +1,91 @@
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#include <math.h>
+#include "Vector.h"
+#include "Matrix4x4.h"
+
+// Pinhole camera of shader.frag's getRay(): the ray through pixel (x, y),
+// counted from the lower left corner, is
+// dir + (dir x up)*(x - width/2)*stepX + up*(y - height/2)*stepY.
+struct Camera
+{
+    Camera(const Vec3f& pos, const Vec3f& up, const Vec3f& dir, float fovy, int screenWidth, int screenHeight)
+        : pos(pos),
+          up(up),
+          dir(dir)
+    {
+        float focalLength = 1.f;
+
+        float aspect = (float)screenWidth / (float)screenHeight;
+
+        float height = focalLength / (2*tan(fovy/2.f));
+        float width = aspect * height;
+
+        stepX = width / screenWidth;
+        stepY = height / screenHeight;
+    }
+
+    ~Camera()
+    {
+    }
+
+    void moveForward(float dt)
+    {
+        pos += dir * dt * 0.25f;
+    }
+
+    void moveBackward(float dt)
+    {
+        pos -= dir * dt * 0.25f;
+    }
+
+    void moveLeft(float dt)
+    {
+        pos -= dir.cross(up) * dt * 0.25f;
+    }
+
+    void moveRight(float dt)
+    {
+        pos += dir.cross(up) * dt * 0.25f;
+    }
+
+    void rotateX(float dt)
+    {
+        Matrix4x4f a = Matrix4x4f::Identity()
+                       .RotateY(dt*0.01f);
+        up = a*up;
+        dir = a*dir;
+    }
+
+    void rotateY(float dt)
+    {
+        Matrix4x4f a = Matrix4x4f::Identity()
+                       .Rotate(-dt*0.01f, dir.cross(up));
+        Vec3f newUp = a*up;
+        if(newUp.dot(Vec3f(0.f,1.f,0.f)) > 0.f)
+        {
+            up = newUp;
+            dir = a*dir;
+        }
+    }
+
+    Vec3f pos;
+    Vec3f up;
+    Vec3f dir;
+
+    float stepX;
+    float stepY;
+};
+
+// Start view of the viewer
+inline Camera defaultCamera(int screenWidth, int screenHeight)
+{
+    return Camera(Vec3f(0.0610065f, 0.0558378f, 0.150712f),
+                  Vec3f(0.114496f, 0.966392f, -0.230176f),
+                  Vec3f(0.430408f, 0.257082f, 0.865253f),
+                  45.f/180.f*3.14159265f,
+                  screenWidth, screenHeight);
+}
+
+#endif
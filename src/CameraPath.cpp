@@ -0,0 +1,85 @@
+#include "CameraPath.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <initializer_list>
+
+static const char WORLD_PREFIX[] = "# world: ";
+
+std::string cameraPathWorld(const WorldParams& params)
+{
+    std::ostringstream world;
+    world << params.width << "x" << params.height << "x" << params.depth << " " << WORLD_GENERATOR_VERSION;
+    return world.str();
+}
+
+bool loadCameraPath(const std::string& filename, CameraPath& path, std::string* world)
+{
+    std::ifstream in(filename.c_str());
+    if(!in)
+        return false;
+
+    path.clear();
+    if(world)
+        world->clear();
+    std::string line;
+    while(std::getline(in, line))
+    {
+        if(!line.compare(0, sizeof(WORLD_PREFIX) - 1, WORLD_PREFIX))
+        {
+            if(world)
+            {
+                *world = line.substr(sizeof(WORLD_PREFIX) - 1);
+                world->erase(world->find_last_not_of(" \t\r") + 1);
+            }
+            continue;
+        }
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos || line[first] == '#')
+            continue;
+
+        CameraPose pose;
+        std::istringstream fields(line);
+        for(Vec3f* v : { &pose.pos, &pose.up, &pose.dir })
+        {
+            for(int i=0; i<3; ++i)
+                fields >> (*v)[i];
+        }
+        if(!fields)
+            return false;
+        path.push_back(pose);
+    }
+    return true;
+}
+
+bool saveCameraPath(const std::string& filename, const CameraPath& path, const std::string& world, const std::string& description)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if(!file)
+        return false;
+
+    // 9 significant digits round trip floats exactly
+    if(!description.empty())
+        fprintf(file, "# %s\n", description.c_str());
+    fprintf(file, "%s%s\n", WORLD_PREFIX, world.c_str());
+    fprintf(file, "# camera path: px py pz  ux uy uz  dx dy dz per frame\n");
+    for(const CameraPose& pose : path)
+    {
+        fprintf(file, "%.9g %.9g %.9g  %.9g %.9g %.9g  %.9g %.9g %.9g\n",
+                pose.pos[0], pose.pos[1], pose.pos[2],
+                pose.up[0], pose.up[1], pose.up[2],
+                pose.dir[0], pose.dir[1], pose.dir[2]);
+    }
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+bool checkCameraPathWorld(std::ostream& out, const std::string& filename, const std::string& world, const WorldParams& params)
+{
+    std::string current = cameraPathWorld(params);
+    if(world == current)
+        return true;
+    out << "Warning: camera path " << filename << " was made in world " << (world.empty() ? "(unknown)" : world)
+        << ", not " << current << "; poses may be inside the terrain\n";
+    return false;
+}
@@ -0,0 +1,59 @@
+#ifndef CAMERAPATH_H_
+#define CAMERAPATH_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "Camera.h"
+#include "World.h"
+
+// Camera poses, one per frame, for repeatable performance runs. The viewer
+// moves the camera by fixed amounts per frame, so a recorded path replays
+// the same frames regardless of frame rate.
+//
+// Paths are text files with one pose per line:
+//   px py pz  ux uy uz  dx dy dz
+// Empty lines and lines starting with '#' are ignored, except for a
+// "# world: " line that names the world the path was made in (see
+// cameraPathWorld()). Poses are only known to be clear of the terrain in
+// that world.
+
+struct CameraPose
+{
+    Vec3f pos;
+    Vec3f up;
+    Vec3f dir;
+};
+
+typedef std::vector<CameraPose> CameraPath;
+
+inline CameraPose cameraPose(const Camera& camera)
+{
+    CameraPose pose = { camera.pos, camera.up, camera.dir };
+    return pose;
+}
+
+inline void applyCameraPose(Camera& camera, const CameraPose& pose)
+{
+    camera.pos = pose.pos;
+    camera.up = pose.up;
+    camera.dir = pose.dir;
+}
+
+// World of the given parameters in path files: size and generator
+// version, e.g. "256x256x256 density-v1".
+std::string cameraPathWorld(const WorldParams& params);
+
+// Returns false if the file cannot be read or a pose line is malformed.
+// With world, the world of the path is stored in it, or an empty string if
+// the file does not name one.
+bool loadCameraPath(const std::string& filename, CameraPath& path, std::string* world = NULL);
+// Writes the world and, if not empty, a description as comments.
+bool saveCameraPath(const std::string& filename, const CameraPath& path, const std::string& world,
+                    const std::string& description = "");
+
+// Prints a warning if a path loaded from filename was not made in the
+// world of params. Returns false then.
+bool checkCameraPathWorld(std::ostream& out, const std::string& filename, const std::string& world, const WorldParams& params);
+
+#endif
@@ -0,0 +1,463 @@
+#include "CpuRenderer.h"
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include "Sampler.h"
+#include "Trace.h"
+#include "PacketTrace.h"
+#include "ShadingVolume.h"
+#include "Profiler.h"
+
+// The functions below follow shader.frag line by line; GLSL built-ins are
+// spelled out where C++ has no equivalent.
+
+static Vec3f mix(const Vec3f& a, const Vec3f& b, float t)
+{
+    return a + (b - a) * t;
+}
+
+static const float MAX_T = 6.f;
+
+static const Vec3f SUN_COLOR(253.f/255.f, 254.f/255.f, 208.f/255.f);
+static const Vec3f SKY_COLOR(0.738f, 0.8125f, 0.8789f);
+
+static Vec3f getRay(const Camera& camera, float screenX, float screenY, int screenWidth, int screenHeight)
+{
+    Vec3f d = camera.dir
+            + camera.dir.cross(camera.up) * ((screenX - screenWidth/2.f) * camera.stepX)
+            + camera.up * ((screenY - screenHeight/2.f) * camera.stepY);
+    d.normalize();
+    return d;
+}
+
+static float distToScene(const DistanceFieldView& world, const Vec3f& pos)
+{
+    return sampleBSpline(world, pos);
+}
+
+static float rand(const Vec3f& n, float dist)
+{
+    float c0 = interpRand2(n, 100.f);
+    float c1 = interpRand2(n, 1000.f);
+    float c2 = interpRand2(n, 7000.f);
+
+    float c = lerp(c1, c0, dist);
+
+    c = lerp(c2, c, std::min(1.f, dist*4.f));
+
+    return 3.f * ((c * 0.5f) + 0.5f);
+}
+
+static Vec3f terrainColor(const Vec3f& n, float intensity)
+{
+    Vec3f green(0.27f, 0.42f, 0.19f);
+    Vec3f gray(0.2f, 0.2f, 0.19f);
+
+    float grayness = expf(-n.dot(Vec3f(0.f, 1.f, 0.f))/0.9f);
+
+    return mix(green, gray, std::min(1.f, grayness)) * intensity;
+}
+
+static Vec3f sceneColor(const Vec3f& pos, const Vec3f& n, float dist)
+{
+    return terrainColor(n, rand(pos, dist));
+}
+
+static Vec3f normal(const DistanceFieldView& world, const Vec3f& pos, bool analytic)
+{
+    if(analytic)
+    {
+        Vec3f gradient;
+        sampleBSplineGradient(world, pos, gradient);
+        gradient.normalize();
+        return gradient;
+    }
+
+    float epsX = 1.f/world.width;
+    float epsY = 1.f/world.height;
+    float epsZ = 1.f/world.depth;
+    Vec3f t(distToScene(world, Vec3f(pos[0]-epsX, pos[1], pos[2])) - distToScene(world, Vec3f(pos[0]+epsX, pos[1], pos[2])),
+            distToScene(world, Vec3f(pos[0], pos[1]-epsY, pos[2])) - distToScene(world, Vec3f(pos[0], pos[1]+epsY, pos[2])),
+            distToScene(world, Vec3f(pos[0], pos[1], pos[2]-epsZ)) - distToScene(world, Vec3f(pos[0], pos[1], pos[2]+epsZ)));
+    t.normalize();
+    return -t;
+}
+
+static Vec3f fog(const Vec3f& color, float dist, float maxDist, const Vec3f& fogColor)
+{
+    float amount = expf(-dist/maxDist*10.f);
+    return mix(color, fogColor, 1.f - amount);
+}
+
+// main() of shader.frag for the ray from o along d
+static Vec3f shade(const DistanceFieldView& world, const ShadingVolume* shading, const Vec3f& o, const Vec3f& d, const TraceResult& r, bool analyticNormals)
+{
+    Vec3f lightDir(0.f, 1.f, 1.f);
+    lightDir.normalize();
+
+    Vec3f color = SKY_COLOR;
+    if(r.hit && shading)
+    {
+        Vec3f p = o + d * r.t;
+        Vec4f texel = sampleShading(*shading, p);
+        Vec3f n = decodeShadingNormal(texel, p);
+        color = terrainColor(n, 3.f * ((texel[3] * 0.5f) + 0.5f)) * std::max(0.3f, n.dot(lightDir));
+    }
+    else if(r.hit)
+    {
+        Vec3f p = o + d * r.t;
+        Vec3f n = normal(world, p, analyticNormals);
+        color = sceneColor(p, n, r.t) * std::max(0.3f, n.dot(lightDir));
+    }
+    color = fog(color, r.t, MAX_T, SKY_COLOR);
+
+    if(!r.hit)
+    {
+        float dd = std::max(0.f, d.dot(lightDir)) - 1.f;
+        float sigma = 0.003f;
+        float a = expf(-0.5f*(dd / sigma)*(dd / sigma))*1.3f;
+        color = mix(SKY_COLOR, SUN_COLOR*1.3f, a);
+    }
+
+    return color;
+}
+
+// Start distances of the rays, one per block of scale x scale pixels.
+// Empty when neither the cone prepass nor reprojection is on.
+struct StartDistances
+{
+    StartDistances()
+        : scale(0), width(0), height(0)
+    {}
+
+    float at(int x, int y) const
+    {
+        return t.empty() ? 0.f : t[y / scale * width + x / scale];
+    }
+
+    int scale;
+    int width;
+    int height;
+    std::vector<float> t;
+};
+
+// Marches one cone per block through the block centre. The cone contains
+// the rays of all pixel centres of the block: their offset from the centre
+// is at most scale/2 pixels on both axes, and normalizing the ray
+// directions, which are at least 1 long, does not increase their distance.
+static StartDistances conePrepass(const DistanceFieldView& world, const Camera& camera, int scale,
+                                  int screenWidth, int screenHeight, RenderStats& stats)
+{
+    ProfileZone zone("cone prepass");
+    StartDistances starts;
+    starts.scale = scale;
+    starts.width = (screenWidth + scale - 1) / scale;
+    starts.height = (screenHeight + scale - 1) / scale;
+    starts.t.resize(starts.width*starts.height);
+
+    float spread = 0.5f * scale * sqrtf(camera.stepX*camera.stepX + camera.stepY*camera.stepY);
+
+    long long steps = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:steps)
+    for(int by=0; by<starts.height; ++by)
+    {
+        for(int bx=0; bx<starts.width; ++bx)
+        {
+            float cx = (bx + 0.5f) * scale;
+            float cy = screenHeight - (by + 0.5f) * scale;
+            Vec3f d = getRay(camera, cx, cy, screenWidth, screenHeight);
+
+            TraceResult r = coneTrace(world, camera.pos, d, spread, MAX_T);
+            starts.t[by*starts.width + bx] = r.t;
+            steps += r.steps;
+        }
+    }
+    stats.prepassSteps += steps;
+    return starts;
+}
+
+// Per pixel start distances from the end points of the previous frame,
+// raised from the cone prepass distances where that is further.
+//
+// The end points are splatted into the current view, keeping the nearest
+// per pixel, and each pixel takes the nearest of its 3x3 neighbourhood, so
+// that surfaces moving in front of the ones behind them are not missed. A
+// pixel whose neighbourhood has a hole, or whose backed-off start point is
+// inside the surface, is disoccluded and keeps the prepass distance.
+static StartDistances reprojectHistory(const DistanceFieldView& world, const FrameHistory& history, const Camera& camera,
+                                       float backoff, const StartDistances& prepass, int screenWidth, int screenHeight,
+                                       RenderStats& stats)
+{
+    ProfileZone zone("reprojection");
+    std::vector<float> nearest(screenWidth*screenHeight, FLT_MAX);
+
+    // dir and up need not be orthogonal: solve v = k*(dir + a*right + b*up)
+    // for the screen offsets a and b with Cramer's rule
+    Vec3f right = camera.dir.cross(camera.up);
+    Vec3f rowZ = right.cross(camera.up), rowX = camera.up.cross(camera.dir), rowY = camera.dir.cross(right);
+    float det = camera.dir.dot(rowZ);
+    for(const Vec3f& point : history.points)
+    {
+        Vec3f v = point - camera.pos;
+        float z = v.dot(rowZ);
+        if(z * det <= 0.f)
+            continue;
+        float sx = screenWidth/2.f + v.dot(rowX) / z / camera.stepX;
+        float sy = screenHeight/2.f + v.dot(rowY) / z / camera.stepY;
+        // the four pixels whose centres surround the point, which closes
+        // the gaps between points where the view magnifies
+        int x0 = (int)floorf(sx - 0.5f), y0 = (int)floorf(screenHeight - sy - 0.5f);
+        float dist = v.length();
+        for(int y=std::max(0, y0); y<=std::min(screenHeight-1, y0+1); ++y)
+        {
+            for(int x=std::max(0, x0); x<=std::min(screenWidth-1, x0+1); ++x)
+            {
+                float& n = nearest[y*screenWidth + x];
+                n = std::min(n, dist);
+            }
+        }
+    }
+
+    StartDistances starts;
+    starts.scale = 1;
+    starts.width = screenWidth;
+    starts.height = screenHeight;
+    starts.t.resize(screenWidth*screenHeight);
+
+    long long reprojected = 0, disoccluded = 0, checks = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:reprojected, disoccluded, checks)
+    for(int y=0; y<screenHeight; ++y)
+    {
+        for(int x=0; x<screenWidth; ++x)
+        {
+            float t0 = prepass.at(x, y);
+            float m = FLT_MAX;
+            bool hole = false;
+            for(int ny=std::max(0, y-1); ny<=std::min(screenHeight-1, y+1); ++ny)
+            {
+                for(int nx=std::max(0, x-1); nx<=std::min(screenWidth-1, x+1); ++nx)
+                {
+                    float n = nearest[ny*screenWidth + nx];
+                    hole |= n == FLT_MAX;
+                    m = std::min(m, n);
+                }
+            }
+
+            if(hole)
+            {
+                ++disoccluded;
+            }
+            else if(m * backoff > t0)
+            {
+                float t = m * backoff;
+                Vec3f d = getRay(camera, x + 0.5f, screenHeight - y - 0.5f, screenWidth, screenHeight);
+                ++checks;
+                if(distToScene(world, camera.pos + d * t) > 0.f)
+                {
+                    t0 = t;
+                    ++reprojected;
+                }
+                else
+                {
+                    ++disoccluded;
+                }
+            }
+            starts.t[y*screenWidth + x] = t0;
+        }
+    }
+    stats.prepassSteps += checks;
+    stats.reprojectedPixels = reprojected;
+    stats.disoccludedPixels = disoccluded;
+    return starts;
+}
+
+// Packets cover PACKET_WIDTH x PACKET_SIZE/PACKET_WIDTH pixels.
+static const int PACKET_WIDTH = 4;
+
+static void renderTile(const DistanceFieldView& world, const DistancePyramid* pyramid, const HeightMap* heights, const ShadingVolume* shading,
+                       const Camera& camera, const RenderSettings& settings, const StartDistances& starts,
+                       int x0, int y0, int x1, int y1, Image& image, Vec3f* endPoints, StepBuffer* steps, RenderStats& stats)
+{
+    if(settings.packets && !settings.hierarchical)
+    {
+        const int packetHeight = PACKET_SIZE / PACKET_WIDTH;
+        float dx[PACKET_SIZE], dy[PACKET_SIZE], dz[PACKET_SIZE], t0[PACKET_SIZE];
+        int px[PACKET_SIZE], py[PACKET_SIZE];
+        TraceResult results[PACKET_SIZE];
+
+        for(int by=y0; by<y1; by+=packetHeight)
+        {
+            for(int bx=x0; bx<x1; bx+=PACKET_WIDTH)
+            {
+                int n = 0;
+                for(int y=by; y<std::min(by + packetHeight, y1); ++y)
+                {
+                    for(int x=bx; x<std::min(bx + PACKET_WIDTH, x1); ++x)
+                    {
+                        Vec3f d = getRay(camera, x + 0.5f, image.height - y - 0.5f, image.width, image.height);
+                        dx[n] = d[0];
+                        dy[n] = d[1];
+                        dz[n] = d[2];
+                        t0[n] = starts.at(x, y);
+                        px[n] = x;
+                        py[n] = y;
+                        ++n;
+                    }
+                }
+
+                sphereTracePacket(world, camera.pos, dx, dy, dz, n, MAX_T, settings.relaxation, t0, heights, results);
+
+                for(int i=0; i<n; ++i)
+                {
+                    Vec3f d(dx[i], dy[i], dz[i]);
+                    stats.steps += results[i].steps;
+                    stats.heightSkips += results[i].heightSkips;
+                    image.at(px[i], py[i]) = shade(world, shading, camera.pos, d, results[i], settings.analyticNormals);
+                    if(endPoints)
+                        endPoints[py[i]*image.width + px[i]] = camera.pos + d * results[i].t;
+                    if(steps)
+                    {
+                        steps->iterations[py[i]*image.width + px[i]] = results[i].steps + results[i].coarseSteps + results[i].heightSkips;
+                        steps->samples[py[i]*image.width + px[i]] = results[i].steps;
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    for(int y=y0; y<y1; ++y)
+    {
+        for(int x=x0; x<x1; ++x)
+        {
+            // fragment centres, y up
+            Vec3f d = getRay(camera, x + 0.5f, image.height - y - 0.5f, image.width, image.height);
+
+            float t0 = starts.at(x, y);
+            TraceResult r = settings.hierarchical ? sphereTraceHierarchical(world, *pyramid, camera.pos, d, MAX_T, settings.relaxation, t0, heights)
+                                                  : sphereTrace(world, camera.pos, d, MAX_T, settings.relaxation, t0, heights);
+            stats.steps += r.steps;
+            stats.coarseSteps += r.coarseSteps;
+            stats.heightSkips += r.heightSkips;
+
+            image.at(x, y) = shade(world, shading, camera.pos, d, r, settings.analyticNormals);
+            if(endPoints)
+                endPoints[y*image.width + x] = camera.pos + d * r.t;
+            if(steps)
+            {
+                steps->iterations[y*image.width + x] = r.steps + r.coarseSteps + r.heightSkips;
+                steps->samples[y*image.width + x] = r.steps;
+            }
+        }
+    }
+}
+
+RenderStats renderImage(const DistanceFieldView& world, const DistancePyramid* pyramid, const HeightMap* heights, const ShadingVolume* shading,
+                        const Camera& camera, const RenderSettings& settings, Image& image,
+                        TileScheduler& scheduler, FrameHistory* history, StepBuffer* steps)
+{
+    ProfileZone zone("render image");
+    RenderSettings tileSettings = settings;
+    tileSettings.hierarchical = settings.hierarchical && pyramid && pyramid->levelCount() > 0;
+    if(heights && heights->empty())
+        heights = NULL;
+    int tileSize = std::max(1, settings.tileSize);
+    int tilesX = (image.width + tileSize - 1) / tileSize;
+    int tilesY = (image.height + tileSize - 1) / tileSize;
+
+    RenderStats stats;
+    StartDistances starts;
+    auto start = std::chrono::steady_clock::now();
+    if(settings.prepassScale > 1)
+        starts = conePrepass(world, camera, settings.prepassScale, image.width, image.height, stats);
+    if(history && history->width == image.width && history->height == image.height)
+        starts = reprojectHistory(world, *history, camera, settings.reprojectionBackoff, starts, image.width, image.height, stats);
+    stats.prepassSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Vec3f* endPoints = NULL;
+    if(history)
+    {
+        history->width = image.width;
+        history->height = image.height;
+        history->points.resize(image.width*image.height);
+        endPoints = history->points.data();
+    }
+
+    if(steps)
+    {
+        steps->width = image.width;
+        steps->height = image.height;
+        steps->iterations.assign(image.width*image.height, 0);
+        steps->samples.assign(image.width*image.height, 0);
+    }
+
+    std::vector<RenderStats> tileStats(tilesX*tilesY);
+    scheduler.run(tilesX*tilesY, [&](int tile) {
+        int x0 = tile % tilesX * tileSize, y0 = tile / tilesX * tileSize;
+        int x1 = std::min(x0 + tileSize, image.width), y1 = std::min(y0 + tileSize, image.height);
+        renderTile(world, pyramid, heights, shading, camera, tileSettings, starts, x0, y0, x1, y1, image, endPoints, steps, tileStats[tile]);
+    });
+
+    stats.seconds = stats.prepassSeconds + scheduler.frameSeconds();
+    for(const RenderStats& t : tileStats)
+    {
+        stats.steps += t.steps;
+        stats.coarseSteps += t.coarseSteps;
+        stats.heightSkips += t.heightSkips;
+    }
+    return stats;
+}
+
+bool writePPM(const std::string& filename, const Image& image)
+{
+    FILE* f = fopen(filename.c_str(), "wb");
+    if(!f)
+        return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", image.width, image.height);
+
+    std::vector<unsigned char> row(image.width*3);
+    for(int y=0; y<image.height; ++y)
+    {
+        for(int x=0; x<image.width; ++x)
+        {
+            for(int c=0; c<3; ++c)
+            {
+                float v = std::min(1.f, std::max(0.f, image.at(x, y)[c]));
+                row[3*x + c] = (unsigned char)(v*255.f + 0.5f);
+            }
+        }
+        fwrite(row.data(), 1, row.size(), f);
+    }
+
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+bool writePFM(const std::string& filename, const Image& image)
+{
+    FILE* f = fopen(filename.c_str(), "wb");
+    if(!f)
+        return false;
+
+    // negative scale: little endian; rows are stored bottom to top
+    fprintf(f, "PF\n%d %d\n-1.0\n", image.width, image.height);
+
+    std::vector<float> row(image.width*3);
+    for(int y=image.height-1; y>=0; --y)
+    {
+        for(int x=0; x<image.width; ++x)
+        {
+            for(int c=0; c<3; ++c)
+                row[3*x + c] = image.at(x, y)[c];
+        }
+        fwrite(row.data(), sizeof(float), row.size(), f);
+    }
+
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
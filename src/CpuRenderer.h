@@ -0,0 +1,135 @@
+#ifndef CPURENDERER_H_
+#define CPURENDERER_H_
+
+#include <string>
+#include <vector>
+#include "Vector.h"
+#include "Camera.h"
+#include "World.h"
+#include "DistancePyramid.h"
+#include "HeightMap.h"
+#include "TileScheduler.h"
+#include "ShadingVolume.h"
+
+// Linear RGB image, row 0 at the top.
+struct Image
+{
+    Image(int w, int h)
+        : width(w), height(h), pixels(w*h)
+    {}
+
+    int width;
+    int height;
+
+    Vec3f at(int x, int y) const
+    {
+        return pixels[y*width + x];
+    }
+
+    Vec3f& at(int x, int y)
+    {
+        return pixels[y*width + x];
+    }
+
+    std::vector<Vec3f> pixels;
+};
+
+// Binary PPM, clamped to [0, 1] like the framebuffer.
+bool writePPM(const std::string& filename, const Image& image);
+// Little endian PFM, unclamped.
+bool writePFM(const std::string& filename, const Image& image);
+
+struct RenderSettings
+{
+    RenderSettings()
+        : tileSize(16), hierarchical(false), packets(false), relaxation(1.f), prepassScale(0),
+          reprojectionBackoff(0.9f), analyticNormals(true)
+    {}
+
+    int tileSize;       // in pixels
+
+    // Skip empty space with the pyramid passed to renderImage().
+    bool hierarchical;
+
+    // Trace primary rays in SIMD packets (PacketTrace.h). Not combined with
+    // hierarchical marching.
+    bool packets;
+
+    // Over-relaxation factor omega of the march loops (Trace.h), 1 = plain
+    // sphere tracing. Values of 1.2 to 1.8 are sensible.
+    float relaxation;
+
+    // Block size in pixels of the cone marching prepass (coneTrace() in
+    // Trace.h), which finds a start distance for the rays of each block;
+    // 0 disables it. 4 or 8 work best.
+    int prepassScale;
+
+    // With a FrameHistory, rays start at this fraction of the distance of
+    // the nearest reprojected end point of the previous frame. Must be in
+    // (0, 1]: starting beyond the previous hit can tunnel through thin
+    // features.
+    float reprojectionBackoff;
+
+    // Normals from the analytic gradient of the B-spline
+    // (sampleBSplineGradient()) instead of central differences.
+    bool analyticNormals;
+};
+
+// Where the rays of the previous frame ended, for starting the rays of the
+// next one (temporal reprojection). Keep it across frames, like the
+// scheduler; it is overwritten by each frame.
+struct FrameHistory
+{
+    FrameHistory()
+        : width(0), height(0)
+    {}
+
+    int width;
+    int height;
+    std::vector<Vec3f> points;  // ray end points in world space, row 0 at the top
+};
+
+// Per pixel cost of the march loop (see StepStats.h), row 0 at the top.
+// Resized to the image by renderImage().
+struct StepBuffer
+{
+    StepBuffer()
+        : width(0), height(0)
+    {}
+
+    int width;
+    int height;
+    std::vector<int> iterations;
+    std::vector<int> samples;
+};
+
+struct RenderStats
+{
+    RenderStats()
+        : seconds(0.), prepassSeconds(0.), steps(0), coarseSteps(0), heightSkips(0), prepassSteps(0),
+          reprojectedPixels(0), disoccludedPixels(0)
+    {}
+
+    double seconds;         // including the prepass
+    double prepassSeconds;  // cone prepass and reprojection
+    long long steps;        // B-spline lookups of the march loops
+    long long coarseSteps;  // pyramid lookups
+    long long heightSkips;  // height map tiles skipped
+    long long prepassSteps; // B-spline lookups of the cone prepass and the reprojection check
+
+    long long reprojectedPixels;    // rays started from the previous frame
+    long long disoccludedPixels;    // rays for which the reprojection was rejected
+};
+
+// CPU version of shader.frag: renders the world as seen by camera, whose
+// screen size must match the image. Tiles are rendered in parallel by the
+// scheduler; keep it across frames so that it can balance by tile cost.
+// With a history, rays start where the previous frame's rays ended. With a
+// height map, rays skip the space above the terrain. With a shading volume,
+// hits are shaded from it instead of the procedural normal and colour.
+// With a step buffer, the march loop cost of each pixel is written to it.
+RenderStats renderImage(const DistanceFieldView& world, const DistancePyramid* pyramid, const HeightMap* heights, const ShadingVolume* shading,
+                        const Camera& camera, const RenderSettings& settings, Image& image,
+                        TileScheduler& scheduler, FrameHistory* history = NULL, StepBuffer* steps = NULL);
+
+#endif
@@ -0,0 +1,222 @@
+#include "DistanceFieldCache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char DISTANCEFIELD_MAGIC[8] = { 'R', 'M', 'D', 'F', 'I', 'E', 'L', 'D' };
+static const uint32_t DISTANCEFIELD_FORMAT_VERSION = 1;
+static const int MAX_OCTAVES = 16;
+
+// Samples start at this offset, so that they are page aligned in the mapping.
+static const uint64_t DISTANCEFIELD_DATA_OFFSET = 4096;
+
+struct DistanceFieldFileHeader
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t seed;
+    uint32_t engine;
+    uint32_t octaveCount;
+    float octaveScale[MAX_OCTAVES];
+    float octaveAmplitude[MAX_OCTAVES];
+    float octaveErrorBound[MAX_OCTAVES];
+    uint64_t generatorHash;
+    uint64_t dataOffset;
+};
+
+// FNV-1a
+static uint64_t hashString(const char* s)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(; *s; ++s)
+    {
+        hash ^= (unsigned char)*s;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static DistanceFieldFileHeader makeHeader(const WorldParams& params)
+{
+    DistanceFieldFileHeader header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.magic, DISTANCEFIELD_MAGIC, sizeof(header.magic));
+    header.formatVersion = DISTANCEFIELD_FORMAT_VERSION;
+    header.width = params.width;
+    header.height = params.height;
+    header.depth = params.depth;
+    header.seed = WORLD_SEED;
+    header.engine = (uint32_t)params.engine;
+    header.octaveCount = DENSITY_OCTAVE_COUNT;
+    for(int i=0; i<DENSITY_OCTAVE_COUNT && i<MAX_OCTAVES; ++i)
+    {
+        header.octaveScale[i] = DENSITY_OCTAVES[i].scale;
+        header.octaveAmplitude[i] = DENSITY_OCTAVES[i].amplitude;
+        header.octaveErrorBound[i] = params.octaveErrorBound[i];
+    }
+    header.generatorHash = hashString(WORLD_GENERATOR_VERSION);
+    header.dataOffset = DISTANCEFIELD_DATA_OFFSET;
+
+    return header;
+}
+
+static const char* headerMismatch(const DistanceFieldFileHeader& file, const DistanceFieldFileHeader& expected)
+{
+    if(memcmp(file.magic, expected.magic, sizeof(file.magic)))
+        return "not a distance field file";
+    if(file.formatVersion != expected.formatVersion)
+        return "file format version differs";
+    if(file.generatorHash != expected.generatorHash)
+        return "generator version differs";
+    if(file.width != expected.width || file.height != expected.height || file.depth != expected.depth)
+        return "dimensions differ";
+    if(file.seed != expected.seed)
+        return "noise seed differs";
+    if(file.engine != expected.engine)
+        return "distance engine differs";
+    if(file.octaveCount != expected.octaveCount
+        || memcmp(file.octaveScale, expected.octaveScale, sizeof(file.octaveScale))
+        || memcmp(file.octaveAmplitude, expected.octaveAmplitude, sizeof(file.octaveAmplitude))
+        || memcmp(file.octaveErrorBound, expected.octaveErrorBound, sizeof(file.octaveErrorBound)))
+        return "density octaves differ";
+    if(file.dataOffset != expected.dataOffset)
+        return "data offset differs";
+    return NULL;
+}
+
+MappedDistanceField::MappedDistanceField()
+    : _mapping(NULL), _size(0)
+#ifdef WIN32
+    , _file(INVALID_HANDLE_VALUE), _fileMapping(NULL)
+#endif
+{
+}
+
+MappedDistanceField::~MappedDistanceField()
+{
+    close();
+}
+
+bool MappedDistanceField::open(const std::string& filename, const WorldParams& params)
+{
+    close();
+
+#ifdef WIN32
+    _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(_file, &size);
+    _size = (size_t)size.QuadPart;
+
+    _fileMapping = CreateFileMapping(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(_fileMapping)
+        _mapping = (const char*)MapViewOfFile(_fileMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat sb;
+    if(fstat(fd, &sb) == 0 && sb.st_size > 0)
+    {
+        _size = (size_t)sb.st_size;
+        void* p = mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p != MAP_FAILED)
+            _mapping = (const char*)p;
+    }
+    ::close(fd);
+#endif
+
+    if(!_mapping)
+    {
+        close();
+        return false;
+    }
+
+    DistanceFieldFileHeader expected = makeHeader(params);
+    const char* mismatch = "file truncated";
+    if(_size >= sizeof(DistanceFieldFileHeader))
+    {
+        const DistanceFieldFileHeader& header = *(const DistanceFieldFileHeader*)_mapping;
+        mismatch = headerMismatch(header, expected);
+        if(!mismatch && _size < header.dataOffset + (uint64_t)header.width*header.height*header.depth*sizeof(float))
+            mismatch = "file truncated";
+    }
+
+    if(mismatch)
+    {
+        std::cout << "Ignoring cached world " << filename << ": " << mismatch << "\n";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedDistanceField::close()
+{
+#ifdef WIN32
+    if(_mapping)
+        UnmapViewOfFile(_mapping);
+    if(_fileMapping)
+        CloseHandle(_fileMapping);
+    if(_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+    _fileMapping = NULL;
+    _file = INVALID_HANDLE_VALUE;
+#else
+    if(_mapping)
+        munmap((void*)_mapping, _size);
+#endif
+    _mapping = NULL;
+    _size = 0;
+}
+
+DistanceFieldView MappedDistanceField::view() const
+{
+    const DistanceFieldFileHeader& header = *(const DistanceFieldFileHeader*)_mapping;
+    return DistanceFieldView(header.width, header.height, header.depth, (const float*)(_mapping + header.dataOffset));
+}
+
+bool saveDistanceField(const std::string& filename, const DistanceField& field, const WorldParams& params)
+{
+    // write to a temporary file first, so that an interrupted write never
+    // leaves a valid looking file behind
+    std::string tmpFilename = filename + ".tmp";
+
+    FILE* file = fopen(tmpFilename.c_str(), "wb");
+    if(!file)
+        return false;
+
+    DistanceFieldFileHeader header = makeHeader(params);
+    std::vector<char> headerBlock(DISTANCEFIELD_DATA_OFFSET, 0);
+    memcpy(headerBlock.data(), &header, sizeof(header));
+
+    bool ok = fwrite(headerBlock.data(), 1, headerBlock.size(), file) == headerBlock.size()
+           && fwrite(field.data.data(), sizeof(float), field.data.size(), file) == field.data.size();
+    ok = fclose(file) == 0 && ok;
+
+    if(ok)
+    {
+        remove(filename.c_str());
+        ok = rename(tmpFilename.c_str(), filename.c_str()) == 0;
+    }
+    if(!ok)
+        remove(tmpFilename.c_str());
+
+    return ok;
+}
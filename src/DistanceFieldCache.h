@@ -0,0 +1,44 @@
+#ifndef DISTANCEFIELDCACHE_H_
+#define DISTANCEFIELDCACHE_H_
+
+#include <string>
+#include <stddef.h>
+#include "World.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+// Distance field file written by saveDistanceField(), mapped into memory.
+// The samples can be handed to the texture upload without copying.
+class MappedDistanceField
+{
+public:
+    MappedDistanceField();
+    ~MappedDistanceField();
+
+    // Maps the file and checks that its header matches the generator and
+    // params. Returns false, and stays closed, if the file is missing or
+    // was generated differently.
+    bool open(const std::string& filename, const WorldParams& params);
+    void close();
+
+    bool isOpen() const { return _mapping != NULL; }
+
+    DistanceFieldView view() const;
+
+private:
+    MappedDistanceField(const MappedDistanceField&);
+    MappedDistanceField& operator=(const MappedDistanceField&);
+
+    const char* _mapping;
+    size_t _size;
+#ifdef WIN32
+    HANDLE _file;
+    HANDLE _fileMapping;
+#endif
+};
+
+bool saveDistanceField(const std::string& filename, const DistanceField& field, const WorldParams& params);
+
+#endif
@@ -0,0 +1,103 @@
+#include "DistancePyramid.h"
+#include <math.h>
+#include <algorithm>
+
+// reach of the cubic B-spline beyond the cell, in voxels
+static const int FILTER_SUPPORT = 2;
+
+// voxels along an axis that a level 1 cell covers
+static const int FOOTPRINT = 2 + 2*FILTER_SUPPORT;
+
+// Indices of the footprint of each level 1 cell along an axis of n voxels,
+// with the wrap mode of the axis applied.
+static std::vector<int> footprintIndices(int n, bool mirrored)
+{
+    std::vector<int> indices((n/2) * FOOTPRINT);
+    for(int c=0; c<n/2; ++c)
+    {
+        for(int t=0; t<FOOTPRINT; ++t)
+        {
+            int i = 2*c - FILTER_SUPPORT + t;
+            indices[c*FOOTPRINT + t] = mirrored ? mirroredRepeat(i, n) : clampToEdge(i, n);
+        }
+    }
+    return indices;
+}
+
+// Minimum over the footprint along one axis; dst is src halved along it.
+static void footprintMin(const DistanceFieldView& src, DistanceField& dst, int axis, const std::vector<int>& indices)
+{
+#pragma omp parallel for
+    for(int z=0; z<dst.depth; ++z)
+    {
+        for(int y=0; y<dst.height; ++y)
+        {
+            for(int x=0; x<dst.width; ++x)
+            {
+                int p[3] = { x, y, z };
+                const int* footprint = &indices[p[axis] * FOOTPRINT];
+                float minDist = INFINITY;
+                for(int t=0; t<FOOTPRINT; ++t)
+                {
+                    p[axis] = footprint[t];
+                    minDist = std::min(minDist, src.at(p[0], p[1], p[2]));
+                }
+                dst.at(x, y, z) = minDist;
+            }
+        }
+    }
+}
+
+DistancePyramid buildDistancePyramid(const DistanceFieldView& field, int maxLevels)
+{
+    DistancePyramid pyramid;
+
+    int w = field.width, h = field.height, d = field.depth;
+    for(int l=1; l<=maxLevels; ++l)
+    {
+        if(w % 2 || h % 2 || d % 2)
+            break;
+        w /= 2;
+        h /= 2;
+        d /= 2;
+        pyramid.levels.push_back(DistanceField(w, h, d));
+    }
+
+    if(pyramid.levels.empty())
+        return pyramid;
+
+    // The footprint of a level 1 cell is a box, so its minimum is taken one
+    // axis at a time: 3*6 instead of 6^3 reads per cell. x goes first, it
+    // shrinks the data the most for the later passes.
+    DistanceField& first = pyramid.levels[0];
+    DistanceField minX(first.width, field.height, field.depth);
+    footprintMin(field, minX, 0, footprintIndices(field.width, true));
+    DistanceField minXY(first.width, first.height, field.depth);
+    footprintMin(minX.view(), minXY, 1, footprintIndices(field.height, false));
+    footprintMin(minXY.view(), first, 2, footprintIndices(field.depth, true));
+
+    for(size_t l=1; l<pyramid.levels.size(); ++l)
+    {
+        const DistanceField& child = pyramid.levels[l-1];
+        DistanceField& level = pyramid.levels[l];
+
+#pragma omp parallel for
+        for(int z=0; z<level.depth; ++z)
+        {
+            for(int y=0; y<level.height; ++y)
+            {
+                for(int x=0; x<level.width; ++x)
+                {
+                    float minDist = child.at(2*x, 2*y, 2*z);
+                    for(int k=0; k<2; ++k)
+                        for(int j=0; j<2; ++j)
+                            for(int i=0; i<2; ++i)
+                                minDist = std::min(minDist, child.at(2*x+i, 2*y+j, 2*z+k));
+                    level.at(x, y, z) = minDist;
+                }
+            }
+        }
+    }
+
+    return pyramid;
+}
@@ -0,0 +1,37 @@
+#ifndef DISTANCEPYRAMID_H_
+#define DISTANCEPYRAMID_H_
+
+#include <vector>
+#include "World.h"
+#include "Sampler.h"
+
+// Min-distance mip chain of a distance field. A texel of level l covers
+// 2^l x 2^l x 2^l voxels, and is a lower bound of the B-spline filtered
+// distance (sampleBSpline(), bspline_2d_fp()) anywhere inside that cell: level
+// 1 takes the minimum over the cell widened by the filter support of two
+// voxels, higher levels the minimum over their eight children.
+//
+// Levels are only built as long as the cell size divides all dimensions, so
+// that cells line up with the mirrored repeats of the world.
+struct DistancePyramid
+{
+    // levels[l-1] is level l
+    std::vector<DistanceField> levels;
+
+    int levelCount() const
+    {
+        return (int)levels.size();
+    }
+
+    // Cell (cx, cy, cz) of level l, with the wrap modes of worldTex applied
+    // to the cell index.
+    float cell(int l, int cx, int cy, int cz) const
+    {
+        const DistanceField& level = levels[l-1];
+        return level.at(mirroredRepeat(cx, level.width), clampToEdge(cy, level.height), mirroredRepeat(cz, level.depth));
+    }
+};
+
+DistancePyramid buildDistancePyramid(const DistanceFieldView& field, int maxLevels);
+
+#endif
@@ -0,0 +1,108 @@
+#include "FrameTelemetry.h"
+#include "Percentile.h"
+#include <stdio.h>
+#include <fstream>
+#include <algorithm>
+
+FrameTelemetry::FrameTelemetry(int capacity)
+    : _ring(std::max(1, capacity)), _count(0)
+{
+}
+
+void FrameTelemetry::add(FrameSample sample)
+{
+    sample.frame = _count;
+    _ring[_count++ % _ring.size()] = sample;
+}
+
+void FrameTelemetry::setGpuTime(int frame, double ms)
+{
+    if(frame < 0 || frame >= _count || _count - frame > (int)_ring.size())
+        return;
+    _ring[frame % _ring.size()].gpuMs = ms;
+}
+
+std::vector<FrameSample> FrameTelemetry::samples(int last) const
+{
+    int n = std::min(_count, (int)_ring.size());
+    if(last > 0)
+        n = std::min(n, last);
+
+    std::vector<FrameSample> result;
+    result.reserve(n);
+    for(int frame=_count-n; frame<_count; ++frame)
+        result.push_back(_ring[frame % _ring.size()]);
+    return result;
+}
+
+FrameTimeSummary FrameTelemetry::summary(double FrameSample::* time, int last) const
+{
+    FrameTimeSummary summary;
+    std::vector<double> times;
+    for(const FrameSample& sample : samples(last))
+    {
+        double ms = sample.*time;
+        if(ms < 0.)
+            continue;
+        times.push_back(ms);
+        if(summary.worstFrame < 0 || ms > summary.worst)
+        {
+            summary.worst = ms;
+            summary.worstFrame = sample.frame;
+        }
+    }
+    if(times.empty())
+        return summary;
+
+    std::sort(times.begin(), times.end());
+    summary.count = (int)times.size();
+    summary.p50 = percentile(times, 50.);
+    summary.p95 = percentile(times, 95.);
+    summary.p99 = percentile(times, 99.);
+    return summary;
+}
+
+void printPlaybackSummary(std::ostream& out, const FrameTimeSummary& summary, int firstFrame)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "Played %d frames: p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, worst %.3f ms (frame %d)",
+             summary.count, summary.p50, summary.p95, summary.p99, summary.worst, summary.worstFrame - firstFrame);
+    out << line << "\n";
+}
+
+void FrameTelemetry::report(std::ostream& out) const
+{
+    static const struct { const char* name; double FrameSample::* time; } TIMES[] = {
+        { "frame", &FrameSample::frameMs },
+        { "cpu", &FrameSample::cpuMs },
+        { "gpu", &FrameSample::gpuMs },
+        { "present", &FrameSample::presentMs },
+    };
+
+    int frames = std::min(_count, (int)_ring.size());
+    out << "Frame times of the last " << frames << " frames: p50, p95, p99, worst (frame) in ms\n";
+    for(const auto& t : TIMES)
+    {
+        FrameTimeSummary s = summary(t.time);
+        char line[256];
+        if(s.count == 0)
+            snprintf(line, sizeof(line), "  %-8s no times", t.name);
+        else
+            snprintf(line, sizeof(line), "  %-8s %8.3f %8.3f %8.3f %8.3f (%d)", t.name, s.p50, s.p95, s.p99, s.worst, s.worstFrame);
+        out << line << "\n";
+    }
+}
+
+bool FrameTelemetry::writeCsv(const std::string& filename, int last) const
+{
+    std::ofstream out(filename.c_str());
+    out << "frame,frame_ms,cpu_ms,gpu_ms,present_ms\n";
+    for(const FrameSample& sample : samples(last))
+    {
+        out << sample.frame << "," << sample.frameMs << "," << sample.cpuMs << ",";
+        if(sample.gpuMs >= 0.)
+            out << sample.gpuMs;
+        out << "," << sample.presentMs << "\n";
+    }
+    return (bool)out;
+}
@@ -0,0 +1,79 @@
+#ifndef FRAMETELEMETRY_H_
+#define FRAMETELEMETRY_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Frame times of the viewer and of camera path playback in RayMarchingCPU,
+// kept per frame rather than averaged, so that single slow frames (stutters)
+// show up in the percentiles and the worst frame.
+//
+// The last FRAME_TELEMETRY_FRAMES frames are kept in a ring buffer. GPU
+// times come from timer queries whose results arrive frames later, and are
+// filled in with setGpuTime() while the frame is still in the ring.
+
+const int FRAME_TELEMETRY_FRAMES = 1 << 14;
+
+struct FrameSample
+{
+    int frame;
+    double cpuMs;       // from the start of the frame to the swap
+    double gpuMs;       // GPU time of the frame's draw calls, < 0 if unknown
+    double presentMs;   // in the swap, waiting for the GPU and vsync
+    double frameMs;     // start of the frame to the end of the swap
+};
+
+struct FrameTimeSummary
+{
+    FrameTimeSummary()
+        : count(0), p50(0.), p95(0.), p99(0.), worst(0.), worstFrame(-1)
+    {}
+
+    int count;          // frames with a time
+    double p50;
+    double p95;
+    double p99;
+    double worst;
+    int worstFrame;
+};
+
+// Prints "Played <count> frames: p50 ..." for the summary of a camera path
+// playback whose first frame was firstFrame.
+void printPlaybackSummary(std::ostream& out, const FrameTimeSummary& summary, int firstFrame);
+
+class FrameTelemetry
+{
+public:
+    FrameTelemetry(int capacity = FRAME_TELEMETRY_FRAMES);
+
+    // Adds the next frame; sample.frame is set to its number.
+    void add(FrameSample sample);
+
+    // Sets the GPU time of a frame, if it is still in the ring.
+    void setGpuTime(int frame, double ms);
+
+    // frames added so far, also the number of the next one
+    int frames() const { return _count; }
+
+    // The last 'last' frames in the ring, or all of them for 0, oldest
+    // first.
+    std::vector<FrameSample> samples(int last = 0) const;
+
+    // Percentiles of one of the times of the last 'last' frames (0: all in
+    // the ring). Unknown (negative) times are left out.
+    FrameTimeSummary summary(double FrameSample::* time, int last = 0) const;
+
+    // Prints the summaries of all times of the frames in the ring.
+    void report(std::ostream& out) const;
+
+    // CSV with a line per frame of the last 'last' frames (0: all in the
+    // ring); unknown GPU times are empty.
+    bool writeCsv(const std::string& filename, int last = 0) const;
+
+private:
+    std::vector<FrameSample> _ring;
+    int _count;
+};
+
+#endif
@@ -201,6 +201,15 @@ private:
     GLbitfield _bits;
 };
 
+enum class BlendEquation : GLenum
+{
+    Add = GL_FUNC_ADD,
+    Subtract = GL_FUNC_SUBTRACT,
+    ReverseSubtract = GL_FUNC_REVERSE_SUBTRACT,
+    Min = GL_MIN,
+    Max = GL_MAX
+};
+
 enum class PrimitiveType : GLenum
 {
     Points = GL_POINTS,
@@ -274,6 +283,16 @@ public:
         return ClearBits(0);
     }
 
+    void clearColor(float r, float g, float b, float a)
+    {
+        glClearColor(r, g, b, a);
+    }
+
+    void blendEquation(BlendEquation mode)
+    {
+        glBlendEquation((GLenum)mode);
+    }
+
     void drawElements(PrimitiveType mode, GLsizei count, IndicesType type, ptrdiff_t location)
     {
         glDrawElements((GLenum)mode, count, (GLenum)type, (const GLvoid*)location);
@@ -284,6 +303,17 @@ public:
         glDrawArrays((GLenum)mode, first, count);
     }
 
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        glViewport(x, y, width, height);
+    }
+
+    // waits until all commands have been executed
+    void finish()
+    {
+        glFinish();
+    }
+
 private:
     Context(const Context&);
     Context& operator=(const Context&);
@@ -806,13 +836,18 @@ enum class ImageInternalFormat : GLint
     SRGBAlpha = GL_SRGB_ALPHA,
     SRGB8Alpha8 = GL_SRGB8_ALPHA8,
     RGBA32F = GL_RGBA32F,
-    R32F = GL_R32F
+    R32F = GL_R32F,
+    RG32F = GL_RG32F,
+    R16F = GL_R16F,
+    R16SNorm = GL_R16_SNORM,
+    R8SNorm = GL_R8_SNORM
 };
 
 enum class ImageFormat : GLint
 {
     ColorIndex = GL_COLOR_INDEX,
     Red = GL_RED,
+    RG = GL_RG,
     Green = GL_GREEN,
     Blue = GL_BLUE,
     Alpha = GL_ALPHA,
@@ -834,6 +869,7 @@ enum class ImageType : GLint
     UnsignedInt = GL_UNSIGNED_INT,
     Int = GL_INT,
     Float = GL_FLOAT,
+    HalfFloat = GL_HALF_FLOAT,
     UnsignedByte332 = GL_UNSIGNED_BYTE_3_3_2,
     UnsignedByte233Rev = GL_UNSIGNED_BYTE_2_3_3_REV,
     UnsignedShort565 = GL_UNSIGNED_SHORT_5_6_5,
@@ -1083,6 +1119,11 @@ public:
         return TextureTargetParameters<TARGET>();
     }
 
+    static void unbind()
+    {
+        glBindTexture((GLenum)TARGET, 0);
+    }
+
     static void active(int tex)
     {
         glActiveTexture(GL_TEXTURE0 + tex);
@@ -1119,6 +1160,7 @@ public:
         glTexSubImage3D((GLenum)target, level, x, y, z, width, height, depth, (GLenum)image.getFormat(), (GLenum)image.getType(), image.getData());
     }
 
+    GLuint getResource() const { return _textureResource.get(); }
 
 private:
     Resource<GLuint> _textureResource;
@@ -1128,6 +1170,148 @@ typedef Texture<1, TextureTarget::Texture1D> Texture1D;
 typedef Texture<2, TextureTarget::Texture2D> Texture2D;
 typedef Texture<3, TextureTarget::Texture3D> Texture3D;
 
+enum class FramebufferAttachment : GLenum
+{
+    Color0 = GL_COLOR_ATTACHMENT0,
+    Color1 = GL_COLOR_ATTACHMENT1,
+    Color2 = GL_COLOR_ATTACHMENT2,
+    Depth = GL_DEPTH_ATTACHMENT
+};
+
+class Framebuffer
+{
+public:
+    Framebuffer() {}
+
+    void gen()
+    {
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        _framebufferResource = Resource<GLuint>(fbo, [](const GLuint& v) {
+            glDeleteFramebuffers(1, &v);
+        });
+    }
+
+    void bind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, _framebufferResource);
+    }
+
+    // back to the window's framebuffer
+    static void unbind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    static void attach(FramebufferAttachment attachment, const Texture2D& texture, GLint level = 0)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, (GLenum)attachment, GL_TEXTURE_2D, texture.getResource(), level);
+    }
+
+    // fragment shader outputs gl_FragData[0..count-1] go to Color0..
+    static void drawBuffers(int count)
+    {
+        static const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+        glDrawBuffers(count, buffers);
+    }
+
+    // copies Color0 to the window's framebuffer and binds that
+    void blitToWindow(GLint width, GLint height)
+    {
+        blitToWindow(width, height, width, height);
+    }
+
+    // copies the lower left width x height pixels of Color0 to the window,
+    // scaled to windowWidth x windowHeight, and binds the window's
+    // framebuffer
+    void blitToWindow(GLint width, GLint height, GLint windowWidth, GLint windowHeight)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebufferResource);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        GLenum filter = width == windowWidth && height == windowHeight ? GL_NEAREST : GL_LINEAR;
+        glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, filter);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // reads the lower left width x height pixels of an attachment as floats,
+    // rows bottom up, and binds the window's framebuffer
+    void readPixels(FramebufferAttachment attachment, GLint width, GLint height, ImageFormat format, GLfloat* data)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebufferResource);
+        glReadBuffer((GLenum)attachment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, (GLenum)format, GL_FLOAT, data);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // throws if the bound framebuffer cannot be rendered to
+    static void checkStatus()
+    {
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if(status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw GLException("Framebuffer incomplete: status " + toString(status));
+        }
+    }
+
+    GLuint getResource() const { return _framebufferResource.get(); }
+
+private:
+    Resource<GLuint> _framebufferResource;
+};
+
+// GPU time of the commands between begin() and end() (GL_TIME_ELAPSED).
+// Results arrive some frames later; poll isAvailable() before reading one.
+class TimerQuery
+{
+public:
+    // GL 3.3 or ARB_timer_query
+    static bool isSupported()
+    {
+        return GLEW_ARB_timer_query != 0;
+    }
+
+    void gen()
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+        _queryResource = Resource<GLuint>(query, [](const GLuint& v) {
+            glDeleteQueries(1, &v);
+        });
+    }
+
+    // only one time query may be active at a time
+    void begin()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, _queryResource);
+    }
+
+    static void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    bool isAvailable() const
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(_queryResource.get(), GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+
+    double milliseconds() const
+    {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(_queryResource.get(), GL_QUERY_RESULT, &ns);
+        return ns / 1e6;
+    }
+
+    GLuint getResource() const { return _queryResource.get(); }
+
+private:
+    Resource<GLuint> _queryResource;
+};
+
 class Window
 {
 public:
@@ -1143,10 +1327,6 @@ public:
         SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
         _mainWindow = SDL_CreateWindow(windowTitle.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | (fullscreen?SDL_WINDOW_FULLSCREEN:0));
-
-        _t0 = 0;
-        _t1 = 0;
-        _frame = 0;
     }
 
     virtual ~Window()
@@ -1163,29 +1343,19 @@ public:
 
     void swap()
     {
-	    SDL_GL_SwapWindow(_mainWindow);
+        SDL_GL_SwapWindow(_mainWindow);
+    }
 
-        _t1 = SDL_GetTicks();
-        _frame++;
-        if(_t1 - _t0 > 500.f)
-        {
-            float fps = 1000.f / (_t1 - _t0) * _frame;
-            _t0 = _t1;
-            _frame = 0;
-            
-            char title[256];
-            _snprintf(title, 256, "%g fps - %s", fps, _windowTitle.c_str());
-            SDL_SetWindowTitle(_mainWindow, title);
-        }
+    // shows info in front of the window title
+    void setTitleInfo(const std::string& info)
+    {
+        std::string title = info + " - " + _windowTitle;
+        SDL_SetWindowTitle(_mainWindow, title.c_str());
     }
 
 private:
     SDL_Window* _mainWindow;
     std::string _windowTitle;
-
-    unsigned int _t0;
-    unsigned int _t1;
-    int _frame;
 };
 
 #endif
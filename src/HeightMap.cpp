@@ -0,0 +1,59 @@
+#include "HeightMap.h"
+
+// reach of the cubic B-spline beyond a voxel, in voxels: at y, the filter
+// reads voxels down to floor(y - 0.5) - 1
+static const int FILTER_SUPPORT = 2;
+
+HeightMap buildHeightMap(const DistanceFieldView& field, int tileSize)
+{
+    HeightMap map;
+    if(tileSize <= 0 || field.width % tileSize || field.depth % tileSize)
+        return map;
+
+    map.tileSize = tileSize;
+    map.width = field.width / tileSize;
+    map.depth = field.depth / tileSize;
+    map.tileWidth = (float)tileSize / field.width;
+    map.tileDepth = (float)tileSize / field.depth;
+
+    // highest voxel with surface or inside in each column
+    std::vector<int> column(field.width * field.depth, -1);
+#pragma omp parallel for
+    for(int z=0; z<field.depth; ++z)
+    {
+        for(int x=0; x<field.width; ++x)
+        {
+            for(int y=field.height-1; y>=0; --y)
+            {
+                if(field.at(x, y, z) <= 0.f)
+                {
+                    column[z*field.width + x] = y;
+                    break;
+                }
+            }
+        }
+    }
+
+    map.heights.resize(map.width * map.depth);
+#pragma omp parallel for
+    for(int tz=0; tz<map.depth; ++tz)
+    {
+        for(int tx=0; tx<map.width; ++tx)
+        {
+            // columns of the tile, widened by the filter support
+            int top = -1;
+            for(int z=tz*tileSize-FILTER_SUPPORT; z<(tz+1)*tileSize+FILTER_SUPPORT; ++z)
+            {
+                int zz = mirroredRepeat(z, field.depth);
+                for(int x=tx*tileSize-FILTER_SUPPORT; x<(tx+1)*tileSize+FILTER_SUPPORT; ++x)
+                    top = std::max(top, column[zz*field.width + mirroredRepeat(x, field.width)]);
+            }
+
+            // above voxel top + 2.5 the filter only reads voxels above top
+            map.heights[tz*map.width + tx] = (top + FILTER_SUPPORT + 0.5f) / field.height;
+        }
+    }
+
+    map.top = *std::max_element(map.heights.begin(), map.heights.end());
+    return map;
+}
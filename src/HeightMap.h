@@ -0,0 +1,73 @@
+#ifndef HEIGHTMAP_H_
+#define HEIGHTMAP_H_
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "Vector.h"
+#include "World.h"
+#include "Sampler.h"
+
+// Upper bound of the terrain per tile of tileSize x tileSize voxel columns:
+// above height(tx, tz), the B-spline filtered distance (sampleBSpline(),
+// bspline_2d_fp()) is positive everywhere in the tile, so a ray can skip
+// the part of the tile it crosses above that height. top is the highest
+// bound; rising rays above it leave the terrain for good.
+//
+// Heights are normalized like world positions. Tiles are only built if
+// tileSize divides the width and depth of the world, so that they line up
+// with its mirrored repeats.
+struct HeightMap
+{
+    HeightMap()
+        : tileSize(0), width(0), depth(0), tileWidth(0.f), tileDepth(0.f), top(0.f)
+    {}
+
+    int tileSize;       // in voxels
+    int width;          // in tiles
+    int depth;
+    float tileWidth;    // normalized
+    float tileDepth;
+    float top;
+    std::vector<float> heights;
+
+    bool empty() const
+    {
+        return heights.empty();
+    }
+
+    // Height bound of tile (tx, tz), with the wrap modes of worldTex applied
+    // to the tile index.
+    float height(int tx, int tz) const
+    {
+        return heights[mirroredRepeat(tz, depth)*width + mirroredRepeat(tx, width)];
+    }
+
+    // Where the ray o + t*d, at t, can continue: t itself if it is below the
+    // bound of its tile, else where it leaves the space above the tile, or
+    // infinity if it rises above top. Makes progress whenever it skips.
+    float skip(const Vec3f& o, const Vec3f& d, float t) const
+    {
+        Vec3f p = o + d * t;
+        if(p[1] > top && d[1] > 0.f)
+            return INFINITY;
+
+        float cx = floorf(p[0] / tileWidth), cz = floorf(p[2] / tileDepth);
+        float h = height((int)cx, (int)cz);
+        if(p[1] <= h)
+            return t;
+
+        float exit = INFINITY;
+        if(d[0] != 0.f)
+            exit = std::min(exit, ((cx + (d[0] > 0.f ? 1.f : 0.f)) * tileWidth - o[0]) / d[0]);
+        if(d[2] != 0.f)
+            exit = std::min(exit, ((cz + (d[2] > 0.f ? 1.f : 0.f)) * tileDepth - o[2]) / d[2]);
+        if(d[1] < 0.f)
+            exit = std::min(exit, (h - o[1]) / d[1]);
+        return std::max(exit, t) + 1e-5f;
+    }
+};
+
+HeightMap buildHeightMap(const DistanceFieldView& field, int tileSize);
+
+#endif
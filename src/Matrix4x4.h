@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <ostream>
+#include <math.h>
 #include "Vector.h"
 
 template<typename TYPE>
@@ -14,7 +16,7 @@ public:
         std::fill(std::begin(v), std::end(v), (TYPE)0);
     }
 
-    Matrix4x4(const TYPE& v)
+    Matrix4x4(const TYPE& v0)
     {
         std::fill(std::begin(v), std::end(v), v0);
     }
@@ -47,7 +49,7 @@ public:
 
     Matrix4x4<TYPE>& operator=(const Matrix4x4<TYPE>& x)
     {
-        std::copy(x.v, v);
+        std::copy(std::begin(x.v), std::end(x.v), std::begin(v));
         return *this;
     }
 
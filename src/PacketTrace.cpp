@@ -0,0 +1,481 @@
+#include "PacketTrace.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// The SIMD versions evaluate sampleBSpline() with the same arithmetic, lane
+// by lane: 8 trilinear lookups of 8 gathers each, sharing the per-axis
+// coordinates of the two lookups along each axis.
+
+#if defined(__AVX512F__)
+static inline __m512 floor16(__m512 x)
+{
+    return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+static inline __m512 lerp16(__m512 a, __m512 b, __m512 t)
+{
+    return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a)));
+}
+
+// mirroredRepeat() and clampToEdge() of Sampler.h
+static inline __m512i mirroredRepeat16(__m512i i, int n)
+{
+    __m512i period = _mm512_set1_epi32(2*n);
+    __m512 q = floor16(_mm512_div_ps(_mm512_cvtepi32_ps(i), _mm512_set1_ps(2.f*n)));
+    __m512i m = _mm512_sub_epi32(i, _mm512_mullo_epi32(_mm512_cvttps_epi32(q), period));
+    __m512i mirrored = _mm512_sub_epi32(_mm512_set1_epi32(2*n - 1), m);
+    return _mm512_mask_blend_epi32(_mm512_cmplt_epi32_mask(m, _mm512_set1_epi32(n)), mirrored, m);
+}
+
+static inline __m512i clampToEdge16(__m512i i, int n)
+{
+    return _mm512_min_epi32(_mm512_max_epi32(i, _mm512_setzero_si512()), _mm512_set1_epi32(n - 1));
+}
+
+// Texel indices (multiplied by the axis stride) and weight of one
+// trilinear lookup along one axis.
+struct Axis16
+{
+    __m512i i0, i1;
+    __m512 a;
+};
+
+static inline Axis16 axis16(__m512 tn, int size, int stride, bool mirrored)
+{
+    __m512 u = _mm512_sub_ps(_mm512_mul_ps(tn, _mm512_set1_ps((float)size)), _mm512_set1_ps(0.5f));
+    __m512 fu = floor16(u);
+    __m512i i = _mm512_cvttps_epi32(fu);
+    __m512i i1 = _mm512_add_epi32(i, _mm512_set1_epi32(1));
+
+    Axis16 axis;
+    axis.i0 = mirrored ? mirroredRepeat16(i, size) : clampToEdge16(i, size);
+    axis.i1 = mirrored ? mirroredRepeat16(i1, size) : clampToEdge16(i1, size);
+    axis.i0 = _mm512_mullo_epi32(axis.i0, _mm512_set1_epi32(stride));
+    axis.i1 = _mm512_mullo_epi32(axis.i1, _mm512_set1_epi32(stride));
+    axis.a = _mm512_sub_ps(u, fu);
+    return axis;
+}
+
+static inline __m512 trilinear16(const float* data, const Axis16& x, const Axis16& y, const Axis16& z)
+{
+    __m512i z0y0 = _mm512_add_epi32(z.i0, y.i0), z0y1 = _mm512_add_epi32(z.i0, y.i1);
+    __m512i z1y0 = _mm512_add_epi32(z.i1, y.i0), z1y1 = _mm512_add_epi32(z.i1, y.i1);
+
+    __m512 a = lerp16(_mm512_i32gather_ps(_mm512_add_epi32(z0y0, x.i0), data, 4), _mm512_i32gather_ps(_mm512_add_epi32(z0y0, x.i1), data, 4), x.a);
+    __m512 b = lerp16(_mm512_i32gather_ps(_mm512_add_epi32(z0y1, x.i0), data, 4), _mm512_i32gather_ps(_mm512_add_epi32(z0y1, x.i1), data, 4), x.a);
+    __m512 c = lerp16(_mm512_i32gather_ps(_mm512_add_epi32(z1y0, x.i0), data, 4), _mm512_i32gather_ps(_mm512_add_epi32(z1y0, x.i1), data, 4), x.a);
+    __m512 d = lerp16(_mm512_i32gather_ps(_mm512_add_epi32(z1y1, x.i0), data, 4), _mm512_i32gather_ps(_mm512_add_epi32(z1y1, x.i1), data, 4), x.a);
+
+    return lerp16(lerp16(a, b, y.a), lerp16(c, d, y.a), z.a);
+}
+
+// B-spline weights along one axis: the two lookup coordinates t0, t1
+// (normalized) and the weight s1 of the second.
+static inline void weights16(__m512 pos, int size, __m512& t0, __m512& t1, __m512& s1)
+{
+    __m512 n = _mm512_set1_ps((float)size);
+    __m512 p = _mm512_mul_ps(pos, n);
+    __m512 tc = _mm512_add_ps(floor16(_mm512_sub_ps(p, _mm512_set1_ps(0.5f))), _mm512_set1_ps(0.5f));
+
+    __m512 alpha = _mm512_sub_ps(p, tc);
+    __m512 alpha2 = _mm512_mul_ps(alpha, alpha);
+    __m512 alpha3 = _mm512_mul_ps(alpha2, alpha);
+    __m512 sixth = _mm512_set1_ps(1.f/6.f), one = _mm512_set1_ps(1.f), three = _mm512_set1_ps(3.f);
+
+    __m512 w0 = _mm512_mul_ps(sixth, _mm512_add_ps(_mm512_sub_ps(_mm512_add_ps(_mm512_sub_ps(_mm512_setzero_ps(), alpha3), _mm512_mul_ps(three, alpha2)), _mm512_mul_ps(three, alpha)), one));
+    __m512 w1 = _mm512_mul_ps(sixth, _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(three, alpha3), _mm512_mul_ps(_mm512_set1_ps(6.f), alpha2)), _mm512_set1_ps(4.f)));
+    __m512 w2 = _mm512_mul_ps(sixth, _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(-3.f), alpha3), _mm512_mul_ps(three, alpha2)), _mm512_mul_ps(three, alpha)), one));
+    __m512 w3 = _mm512_mul_ps(sixth, alpha3);
+
+    s1 = _mm512_add_ps(w2, w3);
+    t0 = _mm512_div_ps(_mm512_add_ps(_mm512_sub_ps(tc, one), _mm512_div_ps(w1, _mm512_add_ps(w0, w1))), n);
+    t1 = _mm512_div_ps(_mm512_add_ps(_mm512_add_ps(tc, one), _mm512_div_ps(w3, _mm512_add_ps(w2, w3))), n);
+}
+
+static __m512 sampleBSpline16(const DistanceFieldView& v, __m512 px, __m512 py, __m512 pz)
+{
+    __m512 t0x, t1x, s1x, t0y, t1y, s1y, t0z, t1z, s1z;
+    weights16(px, v.width, t0x, t1x, s1x);
+    weights16(py, v.height, t0y, t1y, s1y);
+    weights16(pz, v.depth, t0z, t1z, s1z);
+
+    Axis16 x0 = axis16(t0x, v.width, 1, true), x1 = axis16(t1x, v.width, 1, true);
+    Axis16 y0 = axis16(t0y, v.height, v.width, false), y1 = axis16(t1y, v.height, v.width, false);
+    Axis16 z0 = axis16(t0z, v.depth, v.width*v.height, true), z1 = axis16(t1z, v.depth, v.width*v.height, true);
+
+    __m512 p000 = trilinear16(v.data, x0, y0, z0);
+    __m512 p001 = trilinear16(v.data, x0, y0, z1);
+    __m512 p010 = trilinear16(v.data, x0, y1, z0);
+    __m512 p011 = trilinear16(v.data, x0, y1, z1);
+    __m512 p100 = trilinear16(v.data, x1, y0, z0);
+    __m512 p101 = trilinear16(v.data, x1, y0, z1);
+    __m512 p110 = trilinear16(v.data, x1, y1, z0);
+    __m512 p111 = trilinear16(v.data, x1, y1, z1);
+
+    __m512 ab = lerp16(lerp16(p000, p100, s1x), lerp16(p010, p110, s1x), s1y);
+    __m512 cd = lerp16(lerp16(p001, p101, s1x), lerp16(p011, p111, s1x), s1y);
+    return lerp16(ab, cd, s1z);
+}
+
+// HeightMap::skip() for 16 lanes at the points p = o + t*d: where each
+// lane continues, t itself below the bound of its tile.
+static __m512 heightSkip16(const HeightMap& map, __m512 ox, __m512 oy, __m512 oz, __m512 vdx, __m512 vdy, __m512 vdz,
+                           __m512 t, __m512 px, __m512 py, __m512 pz)
+{
+    __m512 tileWidth = _mm512_set1_ps(map.tileWidth), tileDepth = _mm512_set1_ps(map.tileDepth);
+    __m512 cx = floor16(_mm512_div_ps(px, tileWidth)), cz = floor16(_mm512_div_ps(pz, tileDepth));
+    __m512i ix = mirroredRepeat16(_mm512_cvttps_epi32(cx), map.width);
+    __m512i iz = mirroredRepeat16(_mm512_cvttps_epi32(cz), map.depth);
+    __m512 h = _mm512_i32gather_ps(_mm512_add_epi32(_mm512_mullo_epi32(iz, _mm512_set1_epi32(map.width)), ix), map.heights.data(), 4);
+
+    __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.f), inf = _mm512_set1_ps(INFINITY);
+    __mmask16 posX = _mm512_cmp_ps_mask(vdx, zero, _CMP_GT_OQ), posZ = _mm512_cmp_ps_mask(vdz, zero, _CMP_GT_OQ);
+    __m512 exitX = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_mask_add_ps(cx, posX, cx, one), tileWidth), ox), vdx);
+    __m512 exitZ = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_mask_add_ps(cz, posZ, cz, one), tileDepth), oz), vdz);
+    __m512 exitY = _mm512_div_ps(_mm512_sub_ps(h, oy), vdy);
+    exitX = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(vdx, zero, _CMP_NEQ_OQ), inf, exitX);
+    exitZ = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(vdz, zero, _CMP_NEQ_OQ), inf, exitZ);
+    exitY = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(vdy, zero, _CMP_LT_OQ), inf, exitY);
+    __m512 exit = _mm512_min_ps(_mm512_min_ps(exitX, exitZ), exitY);
+    __m512 skip = _mm512_add_ps(_mm512_max_ps(exit, t), _mm512_set1_ps(1e-5f));
+
+    __mmask16 above = _mm512_cmp_ps_mask(py, h, _CMP_GT_OQ);
+    __mmask16 gone = _mm512_cmp_ps_mask(vdy, zero, _CMP_GT_OQ) & _mm512_cmp_ps_mask(py, _mm512_set1_ps(map.top), _CMP_GT_OQ);
+    return _mm512_mask_blend_ps(gone, _mm512_mask_blend_ps(above, t, skip), inf);
+}
+
+static void sphereTrace16(const DistanceFieldView& world, const Vec3f& o,
+                          const float* dx, const float* dy, const float* dz, int n,
+                          float maxT, float omega, const float* tStart, const HeightMap* heights, TraceResult* results)
+{
+    __m512 ox = _mm512_set1_ps(o[0]), oy = _mm512_set1_ps(o[1]), oz = _mm512_set1_ps(o[2]);
+    __mmask16 lanes = (__mmask16)((1u << n) - 1);
+    __m512 vdx = _mm512_maskz_loadu_ps(lanes, dx);
+    __m512 vdy = _mm512_maskz_loadu_ps(lanes, dy);
+    __m512 vdz = _mm512_maskz_loadu_ps(lanes, dz);
+
+    __m512 t = tStart ? _mm512_maskz_loadu_ps(lanes, tStart) : _mm512_setzero_ps();
+    __m512i steps = _mm512_setzero_si512(), skips = _mm512_setzero_si512();
+    __mmask16 active = lanes, hit = 0;
+
+    __mmask16 rising = _mm512_cmp_ps_mask(vdy, _mm512_setzero_ps(), _CMP_GT_OQ);
+    __m512 vmaxT = _mm512_set1_ps(maxT), minStep = _mm512_set1_ps(0.003f);
+
+    // over-relaxation state per lane, see Trace.h
+    __m512 vomega = _mm512_set1_ps(omega), one = _mm512_set1_ps(1.f);
+    __m512 stepLength = _mm512_setzero_ps(), prevRadius = _mm512_setzero_ps();
+
+    for(;;)
+    {
+        active &= _mm512_cmp_ps_mask(t, vmaxT, _CMP_LT_OQ);
+
+        __m512 px = _mm512_add_ps(ox, _mm512_mul_ps(vdx, t));
+        __m512 py = _mm512_add_ps(oy, _mm512_mul_ps(vdy, t));
+        __m512 pz = _mm512_add_ps(oz, _mm512_mul_ps(vdz, t));
+
+        active &= ~(rising & _mm512_cmp_ps_mask(py, _mm512_set1_ps(1.f), _CMP_GT_OQ));
+        if(!active)
+            break;
+
+        // lanes above the terrain of their tile skip it, until all of them
+        // are below their bounds and march together
+        while(heights)
+        {
+            __m512 skipT = _mm512_min_ps(heightSkip16(*heights, ox, oy, oz, vdx, vdy, vdz, t, px, py, pz), vmaxT);
+            __mmask16 skipping = active & _mm512_cmp_ps_mask(skipT, t, _CMP_GT_OQ);
+            if(!skipping)
+                break;
+            t = _mm512_mask_blend_ps(skipping, t, skipT);
+            stepLength = _mm512_mask_blend_ps(skipping, stepLength, _mm512_setzero_ps());
+            prevRadius = _mm512_mask_blend_ps(skipping, prevRadius, _mm512_setzero_ps());
+            skips = _mm512_mask_add_epi32(skips, skipping, skips, _mm512_set1_epi32(1));
+            active &= _mm512_cmp_ps_mask(t, vmaxT, _CMP_LT_OQ);
+            px = _mm512_add_ps(ox, _mm512_mul_ps(vdx, t));
+            py = _mm512_add_ps(oy, _mm512_mul_ps(vdy, t));
+            pz = _mm512_add_ps(oz, _mm512_mul_ps(vdz, t));
+        }
+        if(!active)
+            break;
+
+        __m512 dist = sampleBSpline16(world, px, py, pz);
+        steps = _mm512_mask_add_epi32(steps, active, steps, _mm512_set1_epi32(1));
+
+        __m512 radius = _mm512_abs_ps(dist);
+        __mmask16 fail = _mm512_cmp_ps_mask(vomega, one, _CMP_GT_OQ)
+                       & _mm512_cmp_ps_mask(_mm512_add_ps(radius, prevRadius), stepLength, _CMP_LT_OQ);
+
+        __mmask16 hitNow = active & ~fail & _mm512_cmp_ps_mask(dist, _mm512_setzero_ps(), _CMP_LE_OQ);
+        hit |= hitNow;
+        active &= ~hitNow;
+
+        __m512 step = _mm512_mul_ps(_mm512_max_ps(dist, _mm512_mul_ps(minStep, t)), vomega);
+        __m512 back = _mm512_sub_ps(stepLength, _mm512_mul_ps(vomega, stepLength));
+        stepLength = _mm512_mask_blend_ps(fail, step, back);
+        vomega = _mm512_mask_blend_ps(fail, vomega, one);
+        prevRadius = radius;
+        t = _mm512_mask_add_ps(t, active, t, stepLength);
+    }
+
+    float tOut[16];
+    int stepsOut[16], skipsOut[16];
+    _mm512_storeu_ps(tOut, t);
+    _mm512_storeu_si512(stepsOut, steps);
+    _mm512_storeu_si512(skipsOut, skips);
+    for(int i=0; i<n; ++i)
+    {
+        results[i] = TraceResult();
+        results[i].t = tOut[i];
+        results[i].hit = (hit >> i) & 1;
+        results[i].steps = stepsOut[i];
+        results[i].heightSkips = skipsOut[i];
+    }
+}
+
+#elif defined(__AVX2__)
+static inline __m256 lerp8(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+// mirroredRepeat() and clampToEdge() of Sampler.h
+static inline __m256i mirroredRepeat8(__m256i i, int n)
+{
+    __m256i period = _mm256_set1_epi32(2*n);
+    __m256 q = _mm256_floor_ps(_mm256_div_ps(_mm256_cvtepi32_ps(i), _mm256_set1_ps(2.f*n)));
+    __m256i m = _mm256_sub_epi32(i, _mm256_mullo_epi32(_mm256_cvttps_epi32(q), period));
+    __m256i mirrored = _mm256_sub_epi32(_mm256_set1_epi32(2*n - 1), m);
+    return _mm256_blendv_epi8(mirrored, m, _mm256_cmpgt_epi32(_mm256_set1_epi32(n), m));
+}
+
+static inline __m256i clampToEdge8(__m256i i, int n)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), _mm256_set1_epi32(n - 1));
+}
+
+// Texel indices (multiplied by the axis stride) and weight of one
+// trilinear lookup along one axis.
+struct Axis8
+{
+    __m256i i0, i1;
+    __m256 a;
+};
+
+static inline Axis8 axis8(__m256 tn, int size, int stride, bool mirrored)
+{
+    __m256 u = _mm256_sub_ps(_mm256_mul_ps(tn, _mm256_set1_ps((float)size)), _mm256_set1_ps(0.5f));
+    __m256 fu = _mm256_floor_ps(u);
+    __m256i i = _mm256_cvttps_epi32(fu);
+    __m256i i1 = _mm256_add_epi32(i, _mm256_set1_epi32(1));
+
+    Axis8 axis;
+    axis.i0 = mirrored ? mirroredRepeat8(i, size) : clampToEdge8(i, size);
+    axis.i1 = mirrored ? mirroredRepeat8(i1, size) : clampToEdge8(i1, size);
+    axis.i0 = _mm256_mullo_epi32(axis.i0, _mm256_set1_epi32(stride));
+    axis.i1 = _mm256_mullo_epi32(axis.i1, _mm256_set1_epi32(stride));
+    axis.a = _mm256_sub_ps(u, fu);
+    return axis;
+}
+
+static inline __m256 trilinear8(const float* data, const Axis8& x, const Axis8& y, const Axis8& z)
+{
+    __m256i z0y0 = _mm256_add_epi32(z.i0, y.i0), z0y1 = _mm256_add_epi32(z.i0, y.i1);
+    __m256i z1y0 = _mm256_add_epi32(z.i1, y.i0), z1y1 = _mm256_add_epi32(z.i1, y.i1);
+
+    __m256 a = lerp8(_mm256_i32gather_ps(data, _mm256_add_epi32(z0y0, x.i0), 4), _mm256_i32gather_ps(data, _mm256_add_epi32(z0y0, x.i1), 4), x.a);
+    __m256 b = lerp8(_mm256_i32gather_ps(data, _mm256_add_epi32(z0y1, x.i0), 4), _mm256_i32gather_ps(data, _mm256_add_epi32(z0y1, x.i1), 4), x.a);
+    __m256 c = lerp8(_mm256_i32gather_ps(data, _mm256_add_epi32(z1y0, x.i0), 4), _mm256_i32gather_ps(data, _mm256_add_epi32(z1y0, x.i1), 4), x.a);
+    __m256 d = lerp8(_mm256_i32gather_ps(data, _mm256_add_epi32(z1y1, x.i0), 4), _mm256_i32gather_ps(data, _mm256_add_epi32(z1y1, x.i1), 4), x.a);
+
+    return lerp8(lerp8(a, b, y.a), lerp8(c, d, y.a), z.a);
+}
+
+// B-spline weights along one axis: the two lookup coordinates t0, t1
+// (normalized) and the weight s1 of the second.
+static inline void weights8(__m256 pos, int size, __m256& t0, __m256& t1, __m256& s1)
+{
+    __m256 n = _mm256_set1_ps((float)size);
+    __m256 p = _mm256_mul_ps(pos, n);
+    __m256 tc = _mm256_add_ps(_mm256_floor_ps(_mm256_sub_ps(p, _mm256_set1_ps(0.5f))), _mm256_set1_ps(0.5f));
+
+    __m256 alpha = _mm256_sub_ps(p, tc);
+    __m256 alpha2 = _mm256_mul_ps(alpha, alpha);
+    __m256 alpha3 = _mm256_mul_ps(alpha2, alpha);
+    __m256 sixth = _mm256_set1_ps(1.f/6.f), one = _mm256_set1_ps(1.f), three = _mm256_set1_ps(3.f);
+
+    __m256 w0 = _mm256_mul_ps(sixth, _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), alpha3), _mm256_mul_ps(three, alpha2)), _mm256_mul_ps(three, alpha)), one));
+    __m256 w1 = _mm256_mul_ps(sixth, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(three, alpha3), _mm256_mul_ps(_mm256_set1_ps(6.f), alpha2)), _mm256_set1_ps(4.f)));
+    __m256 w2 = _mm256_mul_ps(sixth, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-3.f), alpha3), _mm256_mul_ps(three, alpha2)), _mm256_mul_ps(three, alpha)), one));
+    __m256 w3 = _mm256_mul_ps(sixth, alpha3);
+
+    s1 = _mm256_add_ps(w2, w3);
+    t0 = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(tc, one), _mm256_div_ps(w1, _mm256_add_ps(w0, w1))), n);
+    t1 = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(tc, one), _mm256_div_ps(w3, _mm256_add_ps(w2, w3))), n);
+}
+
+static __m256 sampleBSpline8(const DistanceFieldView& v, __m256 px, __m256 py, __m256 pz)
+{
+    __m256 t0x, t1x, s1x, t0y, t1y, s1y, t0z, t1z, s1z;
+    weights8(px, v.width, t0x, t1x, s1x);
+    weights8(py, v.height, t0y, t1y, s1y);
+    weights8(pz, v.depth, t0z, t1z, s1z);
+
+    Axis8 x0 = axis8(t0x, v.width, 1, true), x1 = axis8(t1x, v.width, 1, true);
+    Axis8 y0 = axis8(t0y, v.height, v.width, false), y1 = axis8(t1y, v.height, v.width, false);
+    Axis8 z0 = axis8(t0z, v.depth, v.width*v.height, true), z1 = axis8(t1z, v.depth, v.width*v.height, true);
+
+    __m256 p000 = trilinear8(v.data, x0, y0, z0);
+    __m256 p001 = trilinear8(v.data, x0, y0, z1);
+    __m256 p010 = trilinear8(v.data, x0, y1, z0);
+    __m256 p011 = trilinear8(v.data, x0, y1, z1);
+    __m256 p100 = trilinear8(v.data, x1, y0, z0);
+    __m256 p101 = trilinear8(v.data, x1, y0, z1);
+    __m256 p110 = trilinear8(v.data, x1, y1, z0);
+    __m256 p111 = trilinear8(v.data, x1, y1, z1);
+
+    __m256 ab = lerp8(lerp8(p000, p100, s1x), lerp8(p010, p110, s1x), s1y);
+    __m256 cd = lerp8(lerp8(p001, p101, s1x), lerp8(p011, p111, s1x), s1y);
+    return lerp8(ab, cd, s1z);
+}
+
+// HeightMap::skip() for 8 lanes at the points p = o + t*d: where each lane
+// continues, t itself below the bound of its tile.
+static __m256 heightSkip8(const HeightMap& map, __m256 ox, __m256 oy, __m256 oz, __m256 vdx, __m256 vdy, __m256 vdz,
+                          __m256 t, __m256 px, __m256 py, __m256 pz)
+{
+    __m256 tileWidth = _mm256_set1_ps(map.tileWidth), tileDepth = _mm256_set1_ps(map.tileDepth);
+    __m256 cx = _mm256_floor_ps(_mm256_div_ps(px, tileWidth)), cz = _mm256_floor_ps(_mm256_div_ps(pz, tileDepth));
+    __m256i ix = mirroredRepeat8(_mm256_cvttps_epi32(cx), map.width);
+    __m256i iz = mirroredRepeat8(_mm256_cvttps_epi32(cz), map.depth);
+    __m256 h = _mm256_i32gather_ps(map.heights.data(), _mm256_add_epi32(_mm256_mullo_epi32(iz, _mm256_set1_epi32(map.width)), ix), 4);
+
+    __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), inf = _mm256_set1_ps(INFINITY);
+    __m256 faceX = _mm256_add_ps(cx, _mm256_and_ps(_mm256_cmp_ps(vdx, zero, _CMP_GT_OQ), one));
+    __m256 faceZ = _mm256_add_ps(cz, _mm256_and_ps(_mm256_cmp_ps(vdz, zero, _CMP_GT_OQ), one));
+    __m256 exitX = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(faceX, tileWidth), ox), vdx);
+    __m256 exitZ = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(faceZ, tileDepth), oz), vdz);
+    __m256 exitY = _mm256_div_ps(_mm256_sub_ps(h, oy), vdy);
+    exitX = _mm256_blendv_ps(inf, exitX, _mm256_cmp_ps(vdx, zero, _CMP_NEQ_OQ));
+    exitZ = _mm256_blendv_ps(inf, exitZ, _mm256_cmp_ps(vdz, zero, _CMP_NEQ_OQ));
+    exitY = _mm256_blendv_ps(inf, exitY, _mm256_cmp_ps(vdy, zero, _CMP_LT_OQ));
+    __m256 exit = _mm256_min_ps(_mm256_min_ps(exitX, exitZ), exitY);
+    __m256 skip = _mm256_add_ps(_mm256_max_ps(exit, t), _mm256_set1_ps(1e-5f));
+
+    __m256 above = _mm256_cmp_ps(py, h, _CMP_GT_OQ);
+    __m256 gone = _mm256_and_ps(_mm256_cmp_ps(vdy, zero, _CMP_GT_OQ), _mm256_cmp_ps(py, _mm256_set1_ps(map.top), _CMP_GT_OQ));
+    return _mm256_blendv_ps(_mm256_blendv_ps(t, skip, above), inf, gone);
+}
+
+static void sphereTrace8(const DistanceFieldView& world, const Vec3f& o,
+                         const float* dx, const float* dy, const float* dz, int n,
+                         float maxT, float omega, const float* tStart, const HeightMap* heights, TraceResult* results)
+{
+    float d[3][8] = {}, t0[8] = {};
+    for(int i=0; i<n; ++i)
+    {
+        d[0][i] = dx[i];
+        d[1][i] = dy[i];
+        d[2][i] = dz[i];
+        t0[i] = tStart ? tStart[i] : 0.f;
+    }
+
+    __m256 ox = _mm256_set1_ps(o[0]), oy = _mm256_set1_ps(o[1]), oz = _mm256_set1_ps(o[2]);
+    __m256 vdx = _mm256_loadu_ps(d[0]), vdy = _mm256_loadu_ps(d[1]), vdz = _mm256_loadu_ps(d[2]);
+
+    // lane masks are all ones or all zeros
+    __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), laneIndex));
+    __m256 hit = _mm256_setzero_ps();
+
+    __m256 t = _mm256_loadu_ps(t0);
+    __m256i steps = _mm256_setzero_si256(), skips = _mm256_setzero_si256();
+
+    __m256 rising = _mm256_cmp_ps(vdy, _mm256_setzero_ps(), _CMP_GT_OQ);
+    __m256 vmaxT = _mm256_set1_ps(maxT), minStep = _mm256_set1_ps(0.003f);
+
+    // over-relaxation state per lane, see Trace.h
+    __m256 vomega = _mm256_set1_ps(omega), one = _mm256_set1_ps(1.f);
+    __m256 stepLength = _mm256_setzero_ps(), prevRadius = _mm256_setzero_ps();
+    __m256 signBit = _mm256_set1_ps(-0.f);
+
+    for(;;)
+    {
+        active = _mm256_and_ps(active, _mm256_cmp_ps(t, vmaxT, _CMP_LT_OQ));
+
+        __m256 px = _mm256_add_ps(ox, _mm256_mul_ps(vdx, t));
+        __m256 py = _mm256_add_ps(oy, _mm256_mul_ps(vdy, t));
+        __m256 pz = _mm256_add_ps(oz, _mm256_mul_ps(vdz, t));
+
+        active = _mm256_andnot_ps(_mm256_and_ps(rising, _mm256_cmp_ps(py, _mm256_set1_ps(1.f), _CMP_GT_OQ)), active);
+        if(_mm256_testz_ps(active, active))
+            break;
+
+        // lanes above the terrain of their tile skip it, until all of them
+        // are below their bounds and march together
+        while(heights)
+        {
+            __m256 skipT = _mm256_min_ps(heightSkip8(*heights, ox, oy, oz, vdx, vdy, vdz, t, px, py, pz), vmaxT);
+            __m256 skipping = _mm256_and_ps(active, _mm256_cmp_ps(skipT, t, _CMP_GT_OQ));
+            if(_mm256_testz_ps(skipping, skipping))
+                break;
+            t = _mm256_blendv_ps(t, skipT, skipping);
+            stepLength = _mm256_andnot_ps(skipping, stepLength);
+            prevRadius = _mm256_andnot_ps(skipping, prevRadius);
+            skips = _mm256_sub_epi32(skips, _mm256_castps_si256(skipping));
+            active = _mm256_and_ps(active, _mm256_cmp_ps(t, vmaxT, _CMP_LT_OQ));
+            px = _mm256_add_ps(ox, _mm256_mul_ps(vdx, t));
+            py = _mm256_add_ps(oy, _mm256_mul_ps(vdy, t));
+            pz = _mm256_add_ps(oz, _mm256_mul_ps(vdz, t));
+        }
+        if(_mm256_testz_ps(active, active))
+            break;
+
+        __m256 dist = sampleBSpline8(world, px, py, pz);
+        steps = _mm256_sub_epi32(steps, _mm256_castps_si256(active));
+
+        __m256 radius = _mm256_andnot_ps(signBit, dist);
+        __m256 fail = _mm256_and_ps(_mm256_cmp_ps(vomega, one, _CMP_GT_OQ),
+                                    _mm256_cmp_ps(_mm256_add_ps(radius, prevRadius), stepLength, _CMP_LT_OQ));
+
+        __m256 hitNow = _mm256_and_ps(_mm256_andnot_ps(fail, active), _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_LE_OQ));
+        hit = _mm256_or_ps(hit, hitNow);
+        active = _mm256_andnot_ps(hitNow, active);
+
+        __m256 step = _mm256_mul_ps(_mm256_max_ps(dist, _mm256_mul_ps(minStep, t)), vomega);
+        __m256 back = _mm256_sub_ps(stepLength, _mm256_mul_ps(vomega, stepLength));
+        stepLength = _mm256_blendv_ps(step, back, fail);
+        vomega = _mm256_blendv_ps(vomega, one, fail);
+        prevRadius = radius;
+        t = _mm256_add_ps(t, _mm256_and_ps(active, stepLength));
+    }
+
+    float tOut[8];
+    int stepsOut[8], skipsOut[8];
+    _mm256_storeu_ps(tOut, t);
+    _mm256_storeu_si256((__m256i*)stepsOut, steps);
+    _mm256_storeu_si256((__m256i*)skipsOut, skips);
+    int hitBits = _mm256_movemask_ps(hit);
+    for(int i=0; i<n; ++i)
+    {
+        results[i] = TraceResult();
+        results[i].t = tOut[i];
+        results[i].hit = (hitBits >> i) & 1;
+        results[i].steps = stepsOut[i];
+        results[i].heightSkips = skipsOut[i];
+    }
+}
+#endif
+
+void sphereTracePacket(const DistanceFieldView& world, const Vec3f& o,
+                       const float* dx, const float* dy, const float* dz, int n,
+                       float maxT, float omega, const float* tStart, const HeightMap* heights, TraceResult* results)
+{
+#if defined(__AVX512F__)
+    sphereTrace16(world, o, dx, dy, dz, n, maxT, omega, tStart, heights, results);
+#elif defined(__AVX2__)
+    sphereTrace8(world, o, dx, dy, dz, n, maxT, omega, tStart, heights, results);
+#else
+    for(int i=0; i<n; ++i)
+        results[i] = sphereTrace(world, o, Vec3f(dx[i], dy[i], dz[i]), maxT, omega, tStart ? tStart[i] : 0.f, heights);
+#endif
+}
@@ -0,0 +1,26 @@
+#ifndef PACKETTRACE_H_
+#define PACKETTRACE_H_
+
+#include "Vector.h"
+#include "World.h"
+#include "Trace.h"
+
+// Rays per packet: 16 with AVX-512, 8 with AVX2. Without either, packets
+// are traced one ray after the other.
+#if defined(__AVX512F__)
+static const int PACKET_SIZE = 16;
+#else
+static const int PACKET_SIZE = 8;
+#endif
+
+// Marches the rays o + t*(dx[i], dy[i], dz[i]), i < n <= PACKET_SIZE, in
+// lockstep, with the same loop as sphereTrace(). Lanes retire as their rays
+// hit or leave; the packet is done when all lanes have retired. Each lane
+// falls back from over-relaxation (omega > 1) on its own. tStart holds the
+// start distance of each ray, or is NULL to start at 0. With a height map,
+// lanes above the terrain of their tile skip it (see HeightMap::skip()).
+void sphereTracePacket(const DistanceFieldView& world, const Vec3f& o,
+                       const float* dx, const float* dy, const float* dz, int n,
+                       float maxT, float omega, const float* tStart, const HeightMap* heights, TraceResult* results);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef PERCENTILE_H_
+#define PERCENTILE_H_
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+// Nearest-rank percentile (0 < p <= 100) of sorted, non-empty samples: the
+// smallest sample that is at least p percent of them are not above.
+template<typename T>
+T percentile(const std::vector<T>& sorted, double p)
+{
+    size_t rank = (size_t)std::max(1., ceil(p / 100. * sorted.size()));
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+#endif
@@ -0,0 +1,304 @@
+#include "Profiler.h"
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <map>
+
+struct ProfileEvent
+{
+    const char* name;
+    int64_t start;
+    int64_t end;
+    int depth;
+};
+
+struct ThreadBuffer
+{
+    explicit ThreadBuffer(int id)
+        : id(id), events(PROFILER_BUFFER_EVENTS), count(0), depth(0)
+    {}
+
+    // recorded events, oldest first
+    std::vector<ProfileEvent> ordered() const
+    {
+        size_t n = std::min(count, events.size());
+        std::vector<ProfileEvent> result;
+        result.reserve(n);
+        for(size_t i=count-n; i<count; ++i)
+            result.push_back(events[i % events.size()]);
+        return result;
+    }
+
+    int id;
+    std::vector<ProfileEvent> events;
+    size_t count;       // events recorded so far, also the next write position
+    int depth;          // zones open on the thread
+};
+
+// Buffers outlive their threads, so that zones of finished threads are
+// still reported.
+static std::mutex gBuffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> gBuffers;
+static thread_local ThreadBuffer* tBuffer = nullptr;
+
+static ThreadBuffer& threadBuffer()
+{
+    if(!tBuffer)
+    {
+        std::lock_guard<std::mutex> lock(gBuffersMutex);
+        gBuffers.emplace_back(new ThreadBuffer((int)gBuffers.size()));
+        tBuffer = gBuffers.back().get();
+    }
+    return *tBuffer;
+}
+
+int64_t profilerNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileZone::ProfileZone(const char* name)
+    : _name(name), _end(0), _depth(threadBuffer().depth++), _open(true)
+{
+    _start = profilerNow();
+}
+
+ProfileZone::~ProfileZone()
+{
+    end();
+}
+
+double ProfileZone::end()
+{
+    if(_open)
+    {
+        _end = profilerNow();
+        _open = false;
+
+        ThreadBuffer& buffer = threadBuffer();
+        ProfileEvent& e = buffer.events[buffer.count++ % buffer.events.size()];
+        e.name = _name;
+        e.start = _start;
+        e.end = _end;
+        e.depth = _depth;
+        --buffer.depth;
+    }
+    return (_end - _start) * 1e-9;
+}
+
+double ProfileZone::stop(const char* infoText)
+{
+    double s = end();
+    char ms[32];
+    snprintf(ms, sizeof(ms), "%.3f ms", s * 1000.);
+    std::cout << infoText << ms << "\n";
+    return s;
+}
+
+double ProfileZone::seconds() const
+{
+    return ((_open ? profilerNow() : _end) - _start) * 1e-9;
+}
+
+// An event with the call path it was recorded under.
+struct PathEvent
+{
+    ProfileEvent e;
+    ProfileEvent root;                  // outermost enclosing zone, or e
+    std::vector<const char*> path;      // enclosing zones and the event itself
+};
+
+static bool startsEarlier(const ProfileEvent& a, const ProfileEvent& b)
+{
+    return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+}
+
+// Events of a buffer with their paths. Parents start before their children,
+// so visiting events by start time keeps the enclosing zones in 'open'. A
+// parent that was overwritten in the ring leaves a gap in the path, filled
+// with "?".
+static std::vector<PathEvent> pathEvents(const ThreadBuffer& buffer)
+{
+    std::vector<ProfileEvent> events = buffer.ordered();
+    std::sort(events.begin(), events.end(), startsEarlier);
+
+    std::vector<PathEvent> result;
+    result.reserve(events.size());
+    std::vector<const char*> open;
+    std::vector<ProfileEvent> openEvents;
+    for(const ProfileEvent& e : events)
+    {
+        while((int)open.size() > e.depth || (!open.empty() && openEvents.back().end <= e.start))
+        {
+            open.pop_back();
+            openEvents.pop_back();
+        }
+        while((int)open.size() < e.depth)
+        {
+            open.push_back("?");
+            openEvents.push_back(e);
+        }
+
+        PathEvent p;
+        p.e = e;
+        p.root = openEvents.empty() ? e : openEvents.front();
+        p.path = open;
+        p.path.push_back(e.name);
+        result.push_back(p);
+
+        open.push_back(e.name);
+        openEvents.push_back(e);
+    }
+    return result;
+}
+
+struct ReportNode
+{
+    std::vector<const char*> path;
+    int64_t firstStart;
+    int64_t total;
+    int calls;
+    std::vector<int> threads;
+};
+
+void profilerReport(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+    if(gBuffers.empty())
+        return;
+
+    std::vector<PathEvent> main = pathEvents(*gBuffers[0]);
+
+    std::map<std::vector<const char*>, ReportNode> nodes;
+    auto add = [&](const std::vector<const char*>& path, const ProfileEvent& e, int thread) {
+        ReportNode& node = nodes[path];
+        if(node.path.empty())
+        {
+            node.path = path;
+            node.firstStart = e.start;
+            node.total = 0;
+            node.calls = 0;
+        }
+        node.firstStart = std::min(node.firstStart, e.start);
+        node.total += e.end - e.start;
+        ++node.calls;
+        if(std::find(node.threads.begin(), node.threads.end(), thread) == node.threads.end())
+            node.threads.push_back(thread);
+    };
+
+    for(const PathEvent& p : main)
+        add(p.path, p.e, 0);
+
+    for(size_t i=1; i<gBuffers.size(); ++i)
+    {
+        for(const PathEvent& p : pathEvents(*gBuffers[i]))
+        {
+            // the innermost main thread zone around the outermost zone of
+            // this event's path: of the zones that start before it, the
+            // latest one that contains it. No zone before an outermost one
+            // that does not contain it can. The main thread's own copy of
+            // a zone in a parallel region is a sibling, not a parent.
+            const ProfileEvent& root = p.root;
+            std::vector<const char*> parent;
+            auto it = std::upper_bound(main.begin(), main.end(), root, [](const ProfileEvent& e, const PathEvent& m) {
+                return startsEarlier(e, m.e);
+            });
+            while(it != main.begin())
+            {
+                --it;
+                if(it->e.end >= root.end && it->e.name != root.name)
+                {
+                    parent = it->path;
+                    break;
+                }
+                if(it->e.depth == 0)
+                    break;
+            }
+            parent.insert(parent.end(), p.path.begin(), p.path.end());
+            add(parent, p.e, (int)i);
+        }
+    }
+
+    // depth first, siblings in order of first appearance: sorted by the
+    // first start times of the path's prefixes
+    std::vector<std::pair<std::vector<int64_t>, const ReportNode*>> sorted;
+    for(const auto& n : nodes)
+    {
+        const std::vector<const char*>& path = n.second.path;
+        std::vector<int64_t> key;
+        for(size_t i=1; i<=path.size(); ++i)
+        {
+            auto prefix = nodes.find(std::vector<const char*>(path.begin(), path.begin() + i));
+            key.push_back(prefix != nodes.end() ? prefix->second.firstStart : n.second.firstStart);
+        }
+        sorted.push_back(std::make_pair(key, &n.second));
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    out << "Profile: total ms, calls, threads\n";
+    for(const auto& entry : sorted)
+    {
+        const ReportNode* node = entry.second;
+        std::string name(2*node->path.size() - 2, ' ');
+        name += node->path.back();
+        char line[256];
+        snprintf(line, sizeof(line), "%-40s %12.3f %8d %4d", name.c_str(), node->total * 1e-6, node->calls, (int)node->threads.size());
+        out << line << "\n";
+    }
+}
+
+static void writeJsonString(std::ostream& out, const char* s)
+{
+    out << '"';
+    for(; *s; ++s)
+    {
+        if(*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+bool writeChromeTrace(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+
+    std::ofstream out(filename.c_str());
+    if(!out)
+        return false;
+
+    int64_t origin = INT64_MAX;
+    for(const auto& buffer : gBuffers)
+    {
+        for(const ProfileEvent& e : buffer->ordered())
+            origin = std::min(origin, e.start);
+    }
+
+    // timestamps and durations in microseconds
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+    bool first = true;
+    for(const auto& buffer : gBuffers)
+    {
+        std::string threadName = buffer->id == 0 ? "main" : "worker " + std::to_string(buffer->id);
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id
+            << ", \"args\": {\"name\": \"" << threadName << "\"}}";
+        first = false;
+
+        for(const ProfileEvent& e : buffer->ordered())
+        {
+            out << ",\n{\"name\": ";
+            writeJsonString(out, e.name);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+                << ", \"ts\": " << (e.start - origin) * 1e-3
+                << ", \"dur\": " << (e.end - e.start) * 1e-3 << "}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,60 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+// Scoped-zone profiler.
+//
+// A ProfileZone measures the time from its construction to end() or the
+// end of its scope on a monotonic clock. Finished zones are recorded, with
+// their nesting depth, in a ring buffer of the calling thread, so zones on
+// different threads (e.g. inside OpenMP regions) never wait for each other.
+// Each thread keeps its last PROFILER_BUFFER_EVENTS zones.
+//
+// profilerReport() sums the recorded zones per call path. Zones that are
+// outermost on a worker thread are counted under the innermost zone of the
+// main thread (the first one to record a zone) that contains them, so the
+// work of parallel regions shows up where it was started. Reports and
+// traces must not be taken while other threads are inside zones.
+
+const int PROFILER_BUFFER_EVENTS = 1 << 16;
+
+// Nanoseconds on a monotonic clock.
+int64_t profilerNow();
+
+class ProfileZone
+{
+public:
+    // name must outlive the profiler, e.g. a string literal.
+    explicit ProfileZone(const char* name);
+    ~ProfileZone();
+
+    // Ends the zone, if it has not ended yet, and returns its time in
+    // seconds. Zones of a thread must end in reverse order of construction.
+    double end();
+
+    // Ends the zone and prints infoText followed by its time.
+    double stop(const char* infoText = "");
+
+    // Time since the zone began, in seconds.
+    double seconds() const;
+
+private:
+    const char* _name;
+    int64_t _start;
+    int64_t _end;
+    int _depth;
+    bool _open;
+};
+
+// Prints the total time, call count and thread count per call path, as an
+// indented tree in order of first appearance.
+void profilerReport(std::ostream& out);
+
+// Writes the recorded zones as Chrome trace events, for chrome://tracing
+// and Perfetto.
+bool writeChromeTrace(const std::string& filename);
+
+#endif
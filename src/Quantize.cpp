@@ -0,0 +1,194 @@
+#include "Quantize.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+uint16_t floatToHalf(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exponent = (int)((x >> 23) & 0xff);
+    uint32_t mantissa = x & 0x7fffff;
+
+    if(exponent == 0xff)                            // inf, nan
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    exponent = exponent - 127 + 15;
+    if(exponent >= 31)                              // overflow
+        return (uint16_t)(sign | 0x7c00);
+
+    int shift = 13;
+    if(exponent <= 0)                               // subnormal
+    {
+        if(exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        exponent = 0;
+    }
+
+    // round to nearest even; a carry out of the mantissa correctly
+    // increments the exponent
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> shift);
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if(rest > halfway || (rest == halfway && (half & 1)))
+        ++half;
+
+    return (uint16_t)(sign | half);
+}
+
+float halfToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+
+    uint32_t x;
+    if(exponent == 0x1f)
+    {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if(exponent == 0)
+    {
+        float f = ldexpf((float)mantissa, -24);
+        return sign ? -f : f;
+    }
+    else
+    {
+        x = sign | ((uint32_t)(exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+const char* encodingName(FieldEncoding encoding)
+{
+    switch(encoding)
+    {
+    case FieldEncoding::Float32:     return "R32F";
+    case FieldEncoding::Half16:      return "R16F";
+    case FieldEncoding::Snorm16:     return "R16_SNORM";
+    case FieldEncoding::NarrowBand8: return "R8_SNORM";
+    }
+    return "";
+}
+
+// Largest half not above v: the nearest one, or the next one towards
+// -infinity if rounding went up (also turns an overflow to inf into the
+// largest finite half).
+static uint16_t floorHalf(float v)
+{
+    uint16_t h = floatToHalf(v);
+    if(halfToFloat(h) > v)
+        h = h & 0x8000 ? h + 1 : (h ? h - 1 : 0x8001);
+    return h;
+}
+
+// Encodes v/scale (clamped to [-1, 1]) with 'levels' steps per unit and
+// returns the code, rounding down.
+static int encodeSnorm(float v, float scale, int levels)
+{
+    float n = std::max(-1.f, std::min(1.f, v / scale));
+    return std::max(-levels, (int)floorf(n * levels));
+}
+
+QuantizedField quantize(const DistanceFieldView& field, FieldEncoding encoding, float band)
+{
+    QuantizedField q;
+    q.encoding = encoding;
+    q.width = field.width;
+    q.height = field.height;
+    q.depth = field.depth;
+
+    int n = field.width * field.height * field.depth;
+
+    switch(encoding)
+    {
+    case FieldEncoding::Float32:
+        q.data.resize(n * sizeof(float));
+        memcpy(q.data.data(), field.data, n * sizeof(float));
+        return q;
+    case FieldEncoding::Half16:
+    case FieldEncoding::Snorm16:
+        q.data.resize(n * sizeof(uint16_t));
+        break;
+    case FieldEncoding::NarrowBand8:
+        q.data.resize(n);
+        break;
+    }
+
+    if(encoding == FieldEncoding::Snorm16)
+    {
+        float maxDist = 0.f;
+        for(int i=0; i<n; ++i)
+            maxDist = std::max(maxDist, fabsf(field.data[i]));
+        q.scale = maxDist > 0.f ? maxDist : 1.f;
+    }
+    else if(encoding == FieldEncoding::NarrowBand8)
+    {
+        q.scale = band;
+    }
+
+    uint16_t* data16 = (uint16_t*)q.data.data();
+    int8_t* data8 = (int8_t*)q.data.data();
+
+    float maxError = 0.f;
+    double sumSqrError = 0.;
+    long long counted = 0;
+    long long clamped = 0;
+
+#pragma omp parallel
+    {
+        float threadMaxError = 0.f;
+
+#pragma omp for reduction(+:sumSqrError, counted, clamped)
+        for(int i=0; i<n; ++i)
+        {
+            float v = field.data[i];
+            float decoded;
+
+            if(encoding == FieldEncoding::Half16)
+            {
+                data16[i] = floorHalf(v);
+                decoded = halfToFloat(data16[i]);
+            }
+            else if(encoding == FieldEncoding::Snorm16)
+            {
+                int c = encodeSnorm(v, q.scale, 32767);
+                data16[i] = (uint16_t)(int16_t)c;
+                decoded = c / 32767.f * q.scale;
+            }
+            else
+            {
+                int c = encodeSnorm(v, q.scale, 127);
+                data8[i] = (int8_t)c;
+                decoded = c / 127.f * q.scale;
+
+                if(fabsf(v) > band)
+                {
+                    ++clamped;
+                    continue;
+                }
+            }
+
+            float e = fabsf(decoded - v);
+            threadMaxError = std::max(threadMaxError, e);
+            sumSqrError += (double)e*e;
+            ++counted;
+        }
+
+#pragma omp critical
+        maxError = std::max(maxError, threadMaxError);
+    }
+
+    q.maxError = maxError;
+    q.rmsError = counted ? (float)sqrt(sumSqrError / counted) : 0.f;
+    q.clamped = (size_t)clamped;
+
+    return q;
+}
@@ -0,0 +1,55 @@
+#ifndef QUANTIZE_H_
+#define QUANTIZE_H_
+
+#include <vector>
+#include <stdint.h>
+#include "World.h"
+
+enum class FieldEncoding
+{
+    Float32,        // R32F, no quantization
+    Half16,         // R16F
+    Snorm16,        // R16_SNORM, scaled by the largest distance
+    NarrowBand8     // R8_SNORM, distances clamped to +-band
+};
+
+// Distance field in one of the texture encodings. The shader reconstructs
+// distances as (filtered texel value) * scale.
+struct QuantizedField
+{
+    QuantizedField()
+        : encoding(FieldEncoding::Float32), width(0), height(0), depth(0),
+          scale(1.f), maxError(0.f), rmsError(0.f), clamped(0)
+    {}
+
+    FieldEncoding encoding;
+    int width;
+    int height;
+    int depth;
+
+    float scale;
+
+    // Texels, 4, 2 or 1 bytes each.
+    std::vector<uint8_t> data;
+
+    // Deviation of the decoded distances from the float field (normalized
+    // world units). For NarrowBand8 only voxels inside the band count;
+    // 'clamped' is the number of voxels outside.
+    float maxError;
+    float rmsError;
+    size_t clamped;
+};
+
+// band is only used by NarrowBand8, in normalized world units. All
+// encodings round towards -infinity (Half16 too, unlike floatToHalf), so
+// decoded distances never exceed the float ones and sphere tracing steps
+// stay conservative.
+QuantizedField quantize(const DistanceFieldView& field, FieldEncoding encoding, float band);
+
+const char* encodingName(FieldEncoding encoding);
+
+// Rounds to the nearest half, ties to even.
+uint16_t floatToHalf(float f);
+float halfToFloat(uint16_t h);
+
+#endif
@@ -0,0 +1,43 @@
+#include "RenderScale.h"
+#include <math.h>
+#include <algorithm>
+
+// weight of a new frame time in the smoothed one
+static const double SMOOTHING = 0.2;
+
+// relative scale change below which the scale is held
+static const float HOLD = 0.05f;
+
+RenderScaleController::RenderScaleController(double budgetMs, float minScale, float maxScale)
+    : _budgetMs(budgetMs), _minScale(minScale), _maxScale(maxScale)
+{
+    reset();
+}
+
+void RenderScaleController::reset()
+{
+    _scale = _maxScale;
+    _smoothedMs = 0.;
+}
+
+bool RenderScaleController::update(double frameMs, float renderedScale)
+{
+    if(frameMs <= 0. || renderedScale <= 0.f)
+        return false;
+
+    // what the frame would have taken at the current scale
+    double ratio = _scale / renderedScale;
+    double ms = frameMs * ratio * ratio;
+    _smoothedMs = _smoothedMs > 0. ? _smoothedMs + SMOOTHING * (ms - _smoothedMs) : ms;
+
+    float target = _scale * (float)sqrt(_budgetMs / _smoothedMs);
+    target = std::min(_maxScale, std::max(_minScale, target));
+    bool bound = target == _minScale || target == _maxScale;
+    if(target == _scale || (!bound && fabsf(target - _scale) < HOLD * _scale))
+        return false;
+
+    ratio = target / _scale;
+    _smoothedMs *= ratio * ratio;
+    _scale = target;
+    return true;
+}
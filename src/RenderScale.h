@@ -0,0 +1,38 @@
+#ifndef RENDERSCALE_H_
+#define RENDERSCALE_H_
+
+// Chooses the fraction of the window resolution (along each axis) to render
+// at, so that frames take about a given time.
+//
+// The cost of a frame is roughly proportional to its pixel count, that is
+// to scale^2, so the scale moves towards scale * sqrt(budget / frame time).
+// Frame times are smoothed, and the scale is held while they stay within a
+// few percent of the budget, so that the resolution does not change every
+// frame.
+class RenderScaleController
+{
+public:
+    RenderScaleController(double budgetMs = 16.7, float minScale = 0.25f, float maxScale = 1.f);
+
+    // Reports the time of a frame rendered at renderedScale, which may be
+    // an earlier scale when timer results arrive late. Returns true if the
+    // scale changed.
+    bool update(double frameMs, float renderedScale);
+
+    // Starts over at full resolution.
+    void reset();
+
+    float scale() const { return _scale; }
+    double budget() const { return _budgetMs; }
+    // smoothed frame time at the current scale
+    double frameTime() const { return _smoothedMs; }
+
+private:
+    double _budgetMs;
+    float _minScale;
+    float _maxScale;
+    float _scale;
+    double _smoothedMs;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <math.h>
+#include "Vector.h"
+
+// CPU versions of the texture lookups that shader.frag performs on
+// worldTex. VOLUME is anything with width, height, depth and at(x, y, z):
+// DistanceField, DistanceFieldView or BrickedDistanceField.
+
+// worldTex repeats mirrored along x and z and clamps along y. GL_CLAMP is
+// emulated as clamp-to-edge, which is what common drivers do.
+inline int mirroredRepeat(int i, int n)
+{
+    int period = 2*n;
+    int m = i % period;
+    if(m < 0)
+        m += period;
+    return m < n ? m : period - 1 - m;
+}
+
+inline int clampToEdge(int i, int n)
+{
+    return i < 0 ? 0 : (i >= n ? n-1 : i);
+}
+
+inline float lerp(float a, float b, float t)
+{
+    return a + t*(b - a);
+}
+
+// GL_LINEAR lookup at normalized texture coordinates.
+template<class VOLUME>
+float sampleTrilinear(const VOLUME& v, float s, float t, float r)
+{
+    float u = s*v.width - 0.5f, vv = t*v.height - 0.5f, w = r*v.depth - 0.5f;
+    float fu = floorf(u), fv = floorf(vv), fw = floorf(w);
+    int i = (int)fu, j = (int)fv, k = (int)fw;
+    float ax = u - fu, ay = vv - fv, az = w - fw;
+
+    int x0 = mirroredRepeat(i, v.width), x1 = mirroredRepeat(i+1, v.width);
+    int y0 = clampToEdge(j, v.height), y1 = clampToEdge(j+1, v.height);
+    int z0 = mirroredRepeat(k, v.depth), z1 = mirroredRepeat(k+1, v.depth);
+
+    float a = lerp(v.at(x0, y0, z0), v.at(x1, y0, z0), ax);
+    float b = lerp(v.at(x0, y1, z0), v.at(x1, y1, z0), ax);
+    float c = lerp(v.at(x0, y0, z1), v.at(x1, y0, z1), ax);
+    float d = lerp(v.at(x0, y1, z1), v.at(x1, y1, z1), ax);
+
+    return lerp(lerp(a, b, ay), lerp(c, d, ay), az);
+}
+
+// Same as bspline_2d_fp() in shader.frag: cubic B-spline filtering from 8
+// trilinear lookups. pos is in normalized texture coordinates.
+template<class VOLUME>
+float sampleBSpline(const VOLUME& v, const Vec3f& pos)
+{
+    int size[3] = { v.width, v.height, v.depth };
+    float s1[3], t0[3], t1[3];
+
+    for(int i=0; i<3; ++i)
+    {
+        float p = pos[i] * size[i];
+        float tc = floorf(p - 0.5f) + 0.5f;
+
+        float alpha = p - tc;
+        float alpha2 = alpha*alpha;
+        float alpha3 = alpha2*alpha;
+        float w0 = 1.f/6.f * (-alpha3 + 3.f*alpha2 - 3.f*alpha + 1.f);
+        float w1 = 1.f/6.f * (3.f*alpha3 - 6.f*alpha2 + 4.f);
+        float w2 = 1.f/6.f * (-3.f*alpha3 + 3.f*alpha2 + 3.f*alpha + 1.f);
+        float w3 = 1.f/6.f * alpha3;
+
+        s1[i] = w2 + w3;
+        t0[i] = (tc - 1.f + w1 / (w0 + w1)) / size[i];
+        t1[i] = (tc + 1.f + w3 / (w2 + w3)) / size[i];
+    }
+
+    float p000 = sampleTrilinear(v, t0[0], t0[1], t0[2]);
+    float p001 = sampleTrilinear(v, t0[0], t0[1], t1[2]);
+    float p010 = sampleTrilinear(v, t0[0], t1[1], t0[2]);
+    float p011 = sampleTrilinear(v, t0[0], t1[1], t1[2]);
+    float p100 = sampleTrilinear(v, t1[0], t0[1], t0[2]);
+    float p101 = sampleTrilinear(v, t1[0], t0[1], t1[2]);
+    float p110 = sampleTrilinear(v, t1[0], t1[1], t0[2]);
+    float p111 = sampleTrilinear(v, t1[0], t1[1], t1[2]);
+
+    float a = lerp(p000, p100, s1[0]);
+    float b = lerp(p010, p110, s1[0]);
+    float ab = lerp(a, b, s1[1]);
+
+    float c = lerp(p001, p101, s1[0]);
+    float d = lerp(p011, p111, s1[0]);
+    float cd = lerp(c, d, s1[1]);
+
+    return lerp(ab, cd, s1[2]);
+}
+
+// Weighted sum of the 8 trilinear lookups at the combinations of x, y and z,
+// the corner (i, j, k) weighted with wx[i]*wy[j]*wz[k].
+template<class VOLUME>
+float sumTrilinear(const VOLUME& v, const float x[2], const float y[2], const float z[2],
+                   const float wx[2], const float wy[2], const float wz[2])
+{
+    float sum = 0.f;
+    for(int k=0; k<2; ++k)
+        for(int j=0; j<2; ++j)
+            for(int i=0; i<2; ++i)
+                sum += wx[i] * wy[j] * wz[k] * sampleTrilinear(v, x[i], y[j], z[k]);
+    return sum;
+}
+
+// sampleBSpline() together with its gradient with respect to pos, like
+// bspline_2d_fp_grad() in shader.frag. The derivative of the cubic B-spline
+// splits into two linear lookups the same way the spline does, with
+// weights -g and g: each gradient component takes 8 trilinear lookups that
+// differ from those of the value only along its own axis. That is 32
+// lookups for value and gradient against 48 for central differences alone.
+template<class VOLUME>
+float sampleBSplineGradient(const VOLUME& v, const Vec3f& pos, Vec3f& gradient)
+{
+    int size[3] = { v.width, v.height, v.depth };
+    float t[3][2], dt[3][2], s[3][2], ds[3][2];
+
+    for(int i=0; i<3; ++i)
+    {
+        float p = pos[i] * size[i];
+        float tc = floorf(p - 0.5f) + 0.5f;
+
+        float alpha = p - tc;
+        float alpha2 = alpha*alpha;
+        float alpha3 = alpha2*alpha;
+        float w0 = 1.f/6.f * (-alpha3 + 3.f*alpha2 - 3.f*alpha + 1.f);
+        float w1 = 1.f/6.f * (3.f*alpha3 - 6.f*alpha2 + 4.f);
+        float w2 = 1.f/6.f * (-3.f*alpha3 + 3.f*alpha2 + 3.f*alpha + 1.f);
+        float w3 = 1.f/6.f * alpha3;
+
+        // derivatives of the weights with respect to alpha; dw0, dw1 <= 0
+        // and dw2, dw3 >= 0, so both pairs are linear lookups again
+        float dw0 = 0.5f * (-alpha2 + 2.f*alpha - 1.f);
+        float dw1 = 0.5f * (3.f*alpha2 - 4.f*alpha);
+        float dw2 = 0.5f * (-3.f*alpha2 + 2.f*alpha + 1.f);
+        float dw3 = 0.5f * alpha2;
+
+        float s1 = w2 + w3;
+        s[i][0] = 1.f - s1;
+        s[i][1] = s1;
+        t[i][0] = (tc - 1.f + w1 / (w0 + w1)) / size[i];
+        t[i][1] = (tc + 1.f + w3 / (w2 + w3)) / size[i];
+
+        float g = (dw2 + dw3) * size[i];
+        ds[i][0] = -g;
+        ds[i][1] = g;
+        dt[i][0] = (tc - 1.f + dw1 / (dw0 + dw1)) / size[i];
+        dt[i][1] = (tc + 1.f + dw3 / (dw2 + dw3)) / size[i];
+    }
+
+    gradient = Vec3f(sumTrilinear(v, dt[0], t[1], t[2], ds[0], s[1], s[2]),
+                     sumTrilinear(v, t[0], dt[1], t[2], s[0], ds[1], s[2]),
+                     sumTrilinear(v, t[0], t[1], dt[2], s[0], s[1], ds[2]));
+    return sumTrilinear(v, t[0], t[1], t[2], s[0], s[1], s[2]);
+}
+
+#endif
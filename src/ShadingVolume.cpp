@@ -0,0 +1,123 @@
+#include "ShadingVolume.h"
+#include <math.h>
+#include <algorithm>
+
+float rand2(const Vec3f& n)
+{
+    float x = sinf(n.dot(Vec3f(10.f, 300.f, 400.f))) * 43758.5453f;
+    return x - floorf(x);
+}
+
+float interpRand2(const Vec3f& n, float gs)
+{
+    Vec3f l, r, f;
+    for(int i=0; i<3; ++i)
+    {
+        l[i] = floorf(n[i] * gs) / gs;
+        r[i] = (floorf(n[i] * gs) + 1.f) / gs;
+        f[i] = 1.f - (r[i] - n[i]) * gs;
+    }
+
+    float p000 = rand2(Vec3f(l[0], l[1], l[2]));
+    float p001 = rand2(Vec3f(l[0], l[1], r[2]));
+    float p010 = rand2(Vec3f(l[0], r[1], l[2]));
+    float p011 = rand2(Vec3f(l[0], r[1], r[2]));
+    float p100 = rand2(Vec3f(r[0], l[1], l[2]));
+    float p101 = rand2(Vec3f(r[0], l[1], r[2]));
+    float p110 = rand2(Vec3f(r[0], r[1], l[2]));
+    float p111 = rand2(Vec3f(r[0], r[1], r[2]));
+
+    return lerp(lerp(lerp(p000, p100, f[0]),
+                     lerp(p001, p101, f[0]),
+                     f[2]),
+                lerp(lerp(p010, p110, f[0]),
+                     lerp(p011, p111, f[0]),
+                     f[2]),
+                f[1]);
+}
+
+static uint8_t unorm8(float x)
+{
+    return (uint8_t)(std::min(1.f, std::max(0.f, x)) * 255.f + 0.5f);
+}
+
+ShadingVolume bakeShadingVolume(const DistanceFieldView& field)
+{
+    ShadingVolume volume;
+    volume.width = field.width;
+    volume.height = field.height;
+    volume.depth = field.depth;
+    volume.data.resize(4 * (size_t)field.width * field.height * field.depth);
+
+    // rand2() at the corners of the detail grid; the voxels interpolate
+    // them like interpRand2() does
+    const int cells = (int)SHADING_DETAIL_SCALE;
+    const int corners = cells + 2;
+    std::vector<float> lattice(corners * corners * corners);
+#pragma omp parallel for
+    for(int k=0; k<corners; ++k)
+        for(int j=0; j<corners; ++j)
+            for(int i=0; i<corners; ++i)
+                lattice[(k*corners + j)*corners + i] = rand2(Vec3f(i / SHADING_DETAIL_SCALE, j / SHADING_DETAIL_SCALE, k / SHADING_DETAIL_SCALE));
+
+    // At voxel centres the B-spline weights are (1, 4, 1)/6 and those of
+    // its derivative (-1, 0, 1)/2, so sampleBSplineGradient() reduces to a
+    // 3x3x3 stencil.
+    const float smooth[3] = { 1.f/6.f, 4.f/6.f, 1.f/6.f };
+
+#pragma omp parallel for
+    for(int z=0; z<field.depth; ++z)
+    {
+        int zs[3] = { mirroredRepeat(z-1, field.depth), z, mirroredRepeat(z+1, field.depth) };
+        for(int y=0; y<field.height; ++y)
+        {
+            int ys[3] = { clampToEdge(y-1, field.height), y, clampToEdge(y+1, field.height) };
+            for(int x=0; x<field.width; ++x)
+            {
+                int xs[3] = { mirroredRepeat(x-1, field.width), x, mirroredRepeat(x+1, field.width) };
+
+                Vec3f n;
+                for(int a=0; a<3; ++a)
+                {
+                    for(int b=0; b<3; ++b)
+                    {
+                        float w = smooth[a] * smooth[b];
+                        n[0] += w * (field.at(xs[2], ys[a], zs[b]) - field.at(xs[0], ys[a], zs[b]));
+                        n[1] += w * (field.at(xs[a], ys[2], zs[b]) - field.at(xs[a], ys[0], zs[b]));
+                        n[2] += w * (field.at(xs[a], ys[b], zs[2]) - field.at(xs[a], ys[b], zs[0]));
+                    }
+                }
+                if(n.sqrlength() > 0.f)
+                    n.normalize();
+                else
+                    n = Vec3f(0.f, 1.f, 0.f);
+
+                // voxel centre, where GL_LINEAR returns the texel unfiltered
+                Vec3f pos((x + 0.5f) / field.width, (y + 0.5f) / field.height, (z + 0.5f) / field.depth);
+                int cell[3];
+                float f[3];
+                for(int i=0; i<3; ++i)
+                {
+                    float c = std::min(std::max(floorf(pos[i] * SHADING_DETAIL_SCALE), 0.f), (float)cells);
+                    cell[i] = (int)c;
+                    f[i] = 1.f - ((c + 1.f) / SHADING_DETAIL_SCALE - pos[i]) * SHADING_DETAIL_SCALE;
+                }
+                float detail = 0.f;
+                for(int c=0; c<8; ++c)
+                {
+                    int dx = c & 1, dy = (c >> 1) & 1, dz = c >> 2;
+                    float w = (dx ? f[0] : 1.f - f[0]) * (dy ? f[1] : 1.f - f[1]) * (dz ? f[2] : 1.f - f[2]);
+                    detail += w * lattice[((cell[2] + dz)*corners + cell[1] + dy)*corners + cell[0] + dx];
+                }
+
+                uint8_t* texel = volume.at(x, y, z);
+                texel[0] = unorm8(n[0]*0.5f + 0.5f);
+                texel[1] = unorm8(n[1]*0.5f + 0.5f);
+                texel[2] = unorm8(n[2]*0.5f + 0.5f);
+                texel[3] = unorm8(detail);
+            }
+        }
+    }
+
+    return volume;
+}
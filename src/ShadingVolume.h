@@ -0,0 +1,89 @@
+#ifndef SHADINGVOLUME_H_
+#define SHADINGVOLUME_H_
+
+#include <stdint.h>
+#include <vector>
+#include "World.h"
+#include "Vector.h"
+#include "Sampler.h"
+
+// RGBA8 companion of the distance field for baked shading, one texel per
+// voxel: rgb is the normal (gradient of the B-spline filtered field,
+// encoded as n*0.5 + 0.5) and a the detail term of the terrain colour,
+// interpRand2() on the coarsest grid of rand() in shader.frag. The finer
+// grids of rand() (1000 and 7000 cells per unit) are far below voxel size
+// and are left out; they would only alias.
+//
+// Shading a hit then takes one GL_LINEAR lookup instead of the gradient and
+// the 24 rand2() hashes.
+struct ShadingVolume
+{
+    ShadingVolume()
+        : width(0), height(0), depth(0)
+    {}
+
+    int width;
+    int height;
+    int depth;
+
+    const uint8_t* at(int x, int y, int z) const
+    {
+        return &data[4*(z*width*height + y*width + x)];
+    }
+
+    uint8_t* at(int x, int y, int z)
+    {
+        return &data[4*(z*width*height + y*width + x)];
+    }
+
+    std::vector<uint8_t> data;
+};
+
+// grid scale of the detail term in cells per unit
+static const float SHADING_DETAIL_SCALE = 100.f;
+
+ShadingVolume bakeShadingVolume(const DistanceFieldView& field);
+
+// rand2() and interp_rand2() of shader.frag
+float rand2(const Vec3f& n);
+float interpRand2(const Vec3f& n, float gs);
+
+// GL_LINEAR lookup of the RGBA8 texture at normalized coordinates, with the
+// wrap modes of worldTex; components in [0, 1].
+inline Vec4f sampleShading(const ShadingVolume& v, const Vec3f& pos)
+{
+    float u = pos[0]*v.width - 0.5f, vv = pos[1]*v.height - 0.5f, w = pos[2]*v.depth - 0.5f;
+    float fu = floorf(u), fv = floorf(vv), fw = floorf(w);
+    int i = (int)fu, j = (int)fv, k = (int)fw;
+    float ax = u - fu, ay = vv - fv, az = w - fw;
+
+    int x[2] = { mirroredRepeat(i, v.width), mirroredRepeat(i+1, v.width) };
+    int y[2] = { clampToEdge(j, v.height), clampToEdge(j+1, v.height) };
+    int z[2] = { mirroredRepeat(k, v.depth), mirroredRepeat(k+1, v.depth) };
+    float wx[2] = { 1.f - ax, ax }, wy[2] = { 1.f - ay, ay }, wz[2] = { 1.f - az, az };
+
+    Vec4f sum(0.f, 0.f, 0.f, 0.f);
+    for(int c=0; c<8; ++c)
+    {
+        const uint8_t* texel = v.at(x[c & 1], y[(c >> 1) & 1], z[c >> 2]);
+        float weight = wx[c & 1] * wy[(c >> 1) & 1] * wz[c >> 2] / 255.f;
+        for(int n=0; n<4; ++n)
+            sum[n] += weight * texel[n];
+    }
+    return sum;
+}
+
+// Normal stored for pos. The texture repeats mirrored along x and z, so the
+// normal is mirrored as well in every other repetition.
+inline Vec3f decodeShadingNormal(const Vec4f& texel, const Vec3f& pos)
+{
+    Vec3f n(texel[0]*2.f - 1.f, texel[1]*2.f - 1.f, texel[2]*2.f - 1.f);
+    if((int)floorf(pos[0]) & 1)
+        n[0] = -n[0];
+    if((int)floorf(pos[2]) & 1)
+        n[2] = -n[2];
+    n.normalize();
+    return n;
+}
+
+#endif
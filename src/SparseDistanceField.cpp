@@ -0,0 +1,148 @@
+#include "SparseDistanceField.h"
+#include <math.h>
+#include <algorithm>
+
+static float mirroredCoord(float u)
+{
+    return 1.f - fabsf(u - 2.f*floorf(u*0.5f) - 1.f);
+}
+
+float SparseDistanceField::fetch(float s, float t, float r) const
+{
+    // Wrapping the coordinate and clamping it to the outermost texel centres
+    // gives the same result as wrapping the texel indices of the lookup.
+    float u = std::min(std::max(mirroredCoord(s)*width, 0.5f), width - 0.5f);
+    float v = std::min(std::max(t*height, 0.5f), height - 0.5f);
+    float w = std::min(std::max(mirroredCoord(r)*depth, 0.5f), depth - 0.5f);
+
+    float fu = floorf(u - 0.5f), fv = floorf(v - 0.5f), fw = floorf(w - 0.5f);
+    int i = (int)fu, j = (int)fv, k = (int)fw;
+    int bx = i / BRICK, by = j / BRICK, bz = k / BRICK;
+
+    size_t b = brickIndex(bx, by, bz);
+    int slot = page[b];
+    if(slot < 0)
+        return pageValue[b];
+
+    int sx = slot % atlasX, sy = slot / atlasX % atlasY, sz = slot / (atlasX*atlasY);
+    int x = sx*SLOT + i - bx*BRICK;
+    int y = sy*SLOT + j - by*BRICK;
+    int z = sz*SLOT + k - bz*BRICK;
+    float ax = u - 0.5f - fu, ay = v - 0.5f - fv, az = w - 0.5f - fw;
+
+    size_t rowStride = (size_t)atlasX*SLOT, sliceStride = rowStride*atlasY*SLOT;
+    const float* p = &atlas[z*sliceStride + y*rowStride + x];
+
+    float a = lerp(p[0], p[1], ax);
+    float bb = lerp(p[rowStride], p[rowStride + 1], ax);
+    float c = lerp(p[sliceStride], p[sliceStride + 1], ax);
+    float d = lerp(p[sliceStride + rowStride], p[sliceStride + rowStride + 1], ax);
+
+    return lerp(lerp(a, bb, ay), lerp(c, d, ay), az);
+}
+
+SparseDistanceField buildSparseDistanceField(const DistanceFieldView& field, float band)
+{
+    const int BRICK = SparseDistanceField::BRICK;
+    const int SLOT = SparseDistanceField::SLOT;
+
+    SparseDistanceField sparse;
+    sparse.width = field.width;
+    sparse.height = field.height;
+    sparse.depth = field.depth;
+    sparse.bricksX = (field.width + BRICK - 1) / BRICK;
+    sparse.bricksY = (field.height + BRICK - 1) / BRICK;
+    sparse.bricksZ = (field.depth + BRICK - 1) / BRICK;
+
+    int maxDim = std::max(field.width, std::max(field.height, field.depth));
+    float normalizedBand = band / maxDim;
+
+    int brickCount = sparse.bricksX*sparse.bricksY*sparse.bricksZ;
+    sparse.page.resize(brickCount);
+    sparse.pageValue.resize(brickCount);
+
+    // Texels outside the volume (slots of partial bricks, the apron at the
+    // border) take the value the wrap modes would give them.
+    auto texel = [&](int x, int y, int z)
+    {
+        return field.at(mirroredRepeat(x, field.width), clampToEdge(y, field.height), mirroredRepeat(z, field.depth));
+    };
+
+#pragma omp parallel for
+    for(int b=0; b<brickCount; ++b)
+    {
+        int bx = b % sparse.bricksX, by = b / sparse.bricksX % sparse.bricksY, bz = b / (sparse.bricksX*sparse.bricksY);
+
+        float minDist = texel(bx*BRICK, by*BRICK, bz*BRICK), maxDist = minDist;
+        for(int z=bz*BRICK; z<bz*BRICK + SLOT; ++z)
+        {
+            for(int y=by*BRICK; y<by*BRICK + SLOT; ++y)
+            {
+                for(int x=bx*BRICK; x<bx*BRICK + SLOT; ++x)
+                {
+                    float d = texel(x, y, z);
+                    minDist = std::min(minDist, d);
+                    maxDist = std::max(maxDist, d);
+                }
+            }
+        }
+
+        if(minDist > normalizedBand)
+        {
+            sparse.page[b] = -1;
+            sparse.pageValue[b] = minDist;
+        }
+        else if(maxDist < -normalizedBand)
+        {
+            sparse.page[b] = -1;
+            sparse.pageValue[b] = maxDist;
+        }
+        else
+        {
+            sparse.page[b] = 0;
+            sparse.pageValue[b] = 0.f;
+        }
+    }
+
+    std::vector<int> surfaceBricks;
+    for(int b=0; b<brickCount; ++b)
+    {
+        if(sparse.page[b] >= 0)
+        {
+            sparse.page[b] = (int)surfaceBricks.size();
+            surfaceBricks.push_back(b);
+        }
+    }
+    sparse.slotCount = surfaceBricks.size();
+
+    // roughly cubic atlas
+    int slots = std::max<int>(1, (int)surfaceBricks.size());
+    sparse.atlasX = (int)ceil(pow((double)slots, 1./3.));
+    sparse.atlasY = sparse.atlasX;
+    sparse.atlasZ = (slots + sparse.atlasX*sparse.atlasY - 1) / (sparse.atlasX*sparse.atlasY);
+
+    size_t rowStride = (size_t)sparse.atlasX*SLOT, sliceStride = rowStride*sparse.atlasY*SLOT;
+    sparse.atlas.assign(sliceStride*sparse.atlasZ*SLOT, 0.f);
+
+#pragma omp parallel for
+    for(int s=0; s<(int)surfaceBricks.size(); ++s)
+    {
+        int b = surfaceBricks[s];
+        int bx = b % sparse.bricksX, by = b / sparse.bricksX % sparse.bricksY, bz = b / (sparse.bricksX*sparse.bricksY);
+        int sx = s % sparse.atlasX, sy = s / sparse.atlasX % sparse.atlasY, sz = s / (sparse.atlasX*sparse.atlasY);
+
+        for(int z=0; z<SLOT; ++z)
+        {
+            for(int y=0; y<SLOT; ++y)
+            {
+                float* row = &sparse.atlas[(sz*SLOT + z)*sliceStride + (sy*SLOT + y)*rowStride + sx*SLOT];
+                for(int x=0; x<SLOT; ++x)
+                {
+                    row[x] = texel(bx*BRICK + x, by*BRICK + y, bz*BRICK + z);
+                }
+            }
+        }
+    }
+
+    return sparse;
+}
@@ -0,0 +1,72 @@
+#ifndef SPARSEDISTANCEFIELD_H_
+#define SPARSEDISTANCEFIELD_H_
+
+#include <vector>
+#include <stddef.h>
+#include "World.h"
+#include "Sampler.h"
+
+// Distance field that only stores bricks near the surface. A page table
+// holds one entry per BRICK^3 brick: either the brick's slot in the atlas,
+// or, for bricks that are entirely empty or entirely solid, a single
+// conservative distance (the smallest distance in empty bricks, the largest
+// in solid ones).
+//
+// Atlas slots hold the brick plus one voxel of its neighbours on the high
+// side, so that every GL_LINEAR lookup reads from a single slot. Lookups
+// within band-2 voxels of the surface are therefore exact; elsewhere they are
+// lower bounds on the distance in empty space.
+struct SparseDistanceField
+{
+    static const int BRICK = 8;
+    static const int SLOT = BRICK + 1;
+
+    int width;
+    int height;
+    int depth;
+
+    int bricksX;
+    int bricksY;
+    int bricksZ;
+
+    // in atlas slots
+    int atlasX;
+    int atlasY;
+    int atlasZ;
+
+    // Per brick: atlas slot, or -1
+    std::vector<int> page;
+    // Per brick: distance returned for bricks without slot
+    std::vector<float> pageValue;
+
+    // Slot s is at (s % atlasX, s / atlasX % atlasY, s / (atlasX*atlasY));
+    // stored like a texture of atlasX*SLOT x atlasY*SLOT x atlasZ*SLOT.
+    std::vector<float> atlas;
+
+    size_t slotCount;
+
+    size_t brickIndex(int bx, int by, int bz) const
+    {
+        return ((size_t)bz*bricksY + by)*bricksX + bx;
+    }
+
+    // GL_LINEAR lookup at normalized coordinates, with the wrap modes of
+    // worldTex. Mirrors sparseTexture() in shader.frag.
+    float fetch(float s, float t, float r) const;
+
+    size_t memorySize() const
+    {
+        return page.size()*(sizeof(int) + sizeof(float)) + atlas.size()*sizeof(float);
+    }
+};
+
+// band is in voxels.
+SparseDistanceField buildSparseDistanceField(const DistanceFieldView& field, float band);
+
+// Lets sampleBSpline() run on the sparse field.
+inline float sampleTrilinear(const SparseDistanceField& v, float s, float t, float r)
+{
+    return v.fetch(s, t, r);
+}
+
+#endif
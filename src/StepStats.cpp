@@ -0,0 +1,32 @@
+#include "StepStats.h"
+#include "Percentile.h"
+#include <math.h>
+#include <algorithm>
+
+StepStatistics stepStatistics(std::vector<int> counts)
+{
+    StepStatistics stats;
+    if(counts.empty())
+        return stats;
+
+    long long sum = 0;
+    for(int c : counts)
+        sum += c;
+    std::sort(counts.begin(), counts.end());
+    stats.mean = (double)sum / counts.size();
+    stats.max = counts.back();
+    stats.p50 = percentile(counts, 50.);
+    stats.p99 = percentile(counts, 99.);
+    return stats;
+}
+
+Vec3f heatmapColor(float count, float maxCount)
+{
+    float x = count / maxCount;
+    if(x > 1.f)
+        return Vec3f(1.f, 1.f, 1.f);
+    x = std::max(x, 0.f);
+    return Vec3f(std::min(1.f, std::max(0.f, 1.5f - fabsf(4.f*x - 3.f))),
+                 std::min(1.f, std::max(0.f, 1.5f - fabsf(4.f*x - 2.f))),
+                 std::min(1.f, std::max(0.f, 1.5f - fabsf(4.f*x - 1.f))));
+}
@@ -0,0 +1,31 @@
+#ifndef STEPSTATS_H_
+#define STEPSTATS_H_
+
+#include <vector>
+#include "Vector.h"
+
+// Per pixel cost of the march loops, the measure to compare marching
+// accelerations with. Iterations are B-spline lookups plus pyramid lookups
+// plus height map skips; samples are the B-spline lookups (distance
+// samples) alone. Shading is not counted.
+
+struct StepStatistics
+{
+    StepStatistics()
+        : mean(0.), p50(0), p99(0), max(0)
+    {}
+
+    double mean;
+    int p50;
+    int p99;
+    int max;
+};
+
+StepStatistics stepStatistics(std::vector<int> counts);
+
+// False colour of count / maxCount, blue through green to red like the
+// "jet" colour map; counts above maxCount are white. Mirrors heatmapColor()
+// in shader.frag.
+Vec3f heatmapColor(float count, float maxCount);
+
+#endif
@@ -0,0 +1,131 @@
+#include "TileScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "Profiler.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+struct TileQueue
+{
+    std::mutex mutex;
+    std::deque<int> tiles;
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TileScheduler::TileScheduler(TileSchedule schedule)
+    : _schedule(schedule), _frameSeconds(0.)
+{
+}
+
+void TileScheduler::deal(int tileCount, int threads, TileQueue* queues)
+{
+    if(_schedule == TileSchedule::Static)
+    {
+        for(int i=0; i<threads; ++i)
+        {
+            for(int tile=tileCount*i/threads; tile<tileCount*(i+1)/threads; ++tile)
+                queues[i].tiles.push_back(tile);
+        }
+    }
+    else
+    {
+        std::vector<int> order(tileCount);
+        for(int tile=0; tile<tileCount; ++tile)
+            order[tile] = tile;
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return _tileCost[a] > _tileCost[b];
+        });
+
+        std::vector<double> load(threads, 0.);
+        for(int tile : order)
+        {
+            int thread = (int)(std::min_element(load.begin(), load.end()) - load.begin());
+            queues[thread].tiles.push_back(tile);
+            load[thread] += _tileCost[tile];
+        }
+    }
+}
+
+void TileScheduler::run(int tileCount, const std::function<void(int)>& renderTile)
+{
+    // until a frame has been measured, all tiles cost the same
+    if((int)_tileCost.size() != tileCount)
+        _tileCost.assign(tileCount, 1.);
+
+    bool steal = _schedule == TileSchedule::WorkStealing;
+    auto start = std::chrono::steady_clock::now();
+
+    // the team may be smaller than omp_get_max_threads() (e.g. with
+    // OMP_THREAD_LIMIT), so tiles are dealt to the threads it actually has
+    int threads = 1;
+    std::unique_ptr<TileQueue[]> queues;
+
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+#ifdef _OPENMP
+            threads = omp_get_num_threads();
+#endif
+            queues.reset(new TileQueue[threads]);
+            deal(tileCount, threads, queues.get());
+            _threadStats.assign(threads, ThreadStats());
+        }
+
+        int self = 0;
+#ifdef _OPENMP
+        self = omp_get_thread_num();
+#endif
+        ThreadStats& stats = _threadStats[self];
+        ProfileZone zone("render tiles");
+
+        for(;;)
+        {
+            int tile = -1;
+            bool stolen = false;
+            {
+                std::lock_guard<std::mutex> lock(queues[self].mutex);
+                if(!queues[self].tiles.empty())
+                {
+                    tile = queues[self].tiles.front();
+                    queues[self].tiles.pop_front();
+                }
+            }
+            for(int i=1; steal && tile < 0 && i<threads; ++i)
+            {
+                TileQueue& victim = queues[(self + i) % threads];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if(!victim.tiles.empty())
+                {
+                    tile = victim.tiles.back();
+                    victim.tiles.pop_back();
+                    stolen = true;
+                }
+            }
+            if(tile < 0)
+                break;
+
+            ProfileZone tileZone("tile");
+            renderTile(tile);
+            double cost = tileZone.end();
+
+            _tileCost[tile] = cost;
+            stats.busy += cost;
+            ++stats.tiles;
+            if(stolen)
+                ++stats.stolen;
+        }
+    }
+
+    _frameSeconds = secondsSince(start);
+    for(auto& stats : _threadStats)
+        stats.idle = std::max(0., _frameSeconds - stats.busy);
+}
@@ -0,0 +1,59 @@
+#ifndef TILESCHEDULER_H_
+#define TILESCHEDULER_H_
+
+#include <vector>
+#include <functional>
+
+struct TileQueue;
+
+enum class TileSchedule
+{
+    Static,         // contiguous ranges of tiles per thread, like omp schedule(static)
+    WorkStealing    // per-thread queues, balanced by last frame's tile costs
+};
+
+// Distributes the tiles of a frame over the OpenMP threads.
+//
+// With work stealing, tiles are sorted by the time they took in the previous
+// frame and dealt, most expensive first, to the thread with the least work
+// so far. Each thread renders its own queue front to back; a thread that
+// runs out steals from the back of the other queues, where the cheapest
+// tiles are.
+class TileScheduler
+{
+public:
+    struct ThreadStats
+    {
+        ThreadStats()
+            : tiles(0), stolen(0), busy(0.), idle(0.)
+        {}
+
+        int tiles;
+        int stolen;
+        double busy;        // seconds spent in renderTile
+        double idle;        // rest of the frame
+    };
+
+    explicit TileScheduler(TileSchedule schedule = TileSchedule::WorkStealing);
+
+    // Calls renderTile(tile) once for each tile in [0, tileCount).
+    void run(int tileCount, const std::function<void(int)>& renderTile);
+
+    // per thread of the last frame's team
+    const std::vector<ThreadStats>& threadStats() const { return _threadStats; }
+    double frameSeconds() const { return _frameSeconds; }
+
+private:
+    // Fills the queues of a team of 'threads'.
+    void deal(int tileCount, int threads, TileQueue* queues);
+
+    TileSchedule _schedule;
+
+    // seconds per tile in the previous frame
+    std::vector<double> _tileCost;
+
+    std::vector<ThreadStats> _threadStats;
+    double _frameSeconds;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <math.h>
+#include <algorithm>
+#include "Vector.h"
+#include "Sampler.h"
+#include "DistancePyramid.h"
+#include "HeightMap.h"
+
+// CPU versions of the march loop in shader.frag.
+//
+// omega > 1 enables over-relaxed sphere tracing (Keinert et al., Enhanced
+// Sphere Tracing): steps are omega times the distance as long as the
+// unbounding spheres of consecutive points overlap. When they stop
+// overlapping, the last step may have skipped a surface; it is undone down
+// to the previous sphere and marching continues with omega = 1.
+//
+// Rays start at tStart, which must be known to be in front of the first
+// surface, e.g. from coneTrace().
+//
+// With a height map, rays skip the tiles they cross above the terrain and
+// stop once they rise above all of it.
+
+struct TraceResult
+{
+    TraceResult()
+        : t(0.f), hit(false), steps(0), coarseSteps(0), heightSkips(0)
+    {}
+
+    float t;
+    bool hit;
+    int steps;          // B-spline lookups
+    int coarseSteps;    // pyramid lookups
+    int heightSkips;    // height map tiles skipped
+};
+
+// Moves r.t past the space above the height map tile the ray is in, if it
+// is above it. Returns false if the ray stays where it is.
+inline bool skipAboveTerrain(const HeightMap* heights, const Vec3f& o, const Vec3f& d, float maxT, TraceResult& r)
+{
+    if(!heights)
+        return false;
+    float t = heights->skip(o, d, r.t);
+    if(t <= r.t)
+        return false;
+    r.t = std::min(t, maxT);
+    ++r.heightSkips;
+    return true;
+}
+
+template<class VOLUME>
+TraceResult sphereTrace(const VOLUME& volume, const Vec3f& o, const Vec3f& d, float maxT, float omega = 1.f, float tStart = 0.f,
+                        const HeightMap* heights = NULL)
+{
+    float stepLength = 0.f, prevRadius = 0.f;
+
+    TraceResult r;
+    r.t = tStart;
+    while(r.t < maxT)
+    {
+        Vec3f p = o + d * r.t;
+        if(p[1] > 1.f && d[1] > 0.f)
+            break;
+        if(skipAboveTerrain(heights, o, d, maxT, r))
+        {
+            stepLength = prevRadius = 0.f;
+            continue;
+        }
+        float dist = sampleBSpline(volume, p);
+        ++r.steps;
+        if(omega > 1.f && fabsf(dist) + prevRadius < stepLength)
+        {
+            stepLength -= omega * stepLength;
+            omega = 1.f;
+        }
+        else if(dist <= 0.f)
+        {
+            r.hit = true;
+            break;
+        }
+        else
+        {
+            stepLength = std::max(dist, 0.003f*r.t) * omega;
+        }
+        prevRadius = fabsf(dist);
+        r.t += stepLength;
+    }
+    return r;
+}
+
+// Same as sphereTrace(), but skips cells of the pyramid that contain no
+// surface, starting at the top level and descending where the bound is not
+// positive. Mirrors the hierarchical branch of main() in shader.frag.
+template<class VOLUME>
+TraceResult sphereTraceHierarchical(const VOLUME& volume, const DistancePyramid& pyramid, const Vec3f& o, const Vec3f& d, float maxT, float omega = 1.f, float tStart = 0.f,
+                                    const HeightMap* heights = NULL)
+{
+    float stepLength = 0.f, prevRadius = 0.f;
+
+    int size[3] = { volume.width, volume.height, volume.depth };
+    int top = pyramid.levelCount();
+    int level = top;
+
+    TraceResult r;
+    r.t = tStart;
+    while(r.t < maxT)
+    {
+        Vec3f p = o + d * r.t;
+        if(p[1] > 1.f && d[1] > 0.f)
+            break;
+        if(skipAboveTerrain(heights, o, d, maxT, r))
+        {
+            stepLength = prevRadius = 0.f;
+            continue;
+        }
+
+        if(level > 0)
+        {
+            float cellSize[3], cell[3];
+            for(int i=0; i<3; ++i)
+            {
+                cellSize[i] = (float)(1 << level) / size[i];
+                cell[i] = floorf(p[i] / cellSize[i]);
+            }
+            float bound = pyramid.cell(level, (int)cell[0], (int)cell[1], (int)cell[2]);
+            ++r.coarseSteps;
+
+            if(bound > 0.f)
+            {
+                // no surface in this cell: continue behind it, on a coarser level
+                float exit = maxT;
+                for(int i=0; i<3; ++i)
+                {
+                    if(d[i] != 0.f)
+                    {
+                        float face = (cell[i] + (d[i] > 0.f ? 1.f : 0.f)) * cellSize[i];
+                        exit = std::min(exit, (face - o[i]) / d[i]);
+                    }
+                }
+                r.t = std::max(exit + 1e-5f, r.t + bound);
+                level = std::min(level + 1, top);
+                stepLength = prevRadius = 0.f;
+            }
+            else
+            {
+                --level;
+            }
+            continue;
+        }
+
+        float dist = sampleBSpline(volume, p);
+        ++r.steps;
+        if(omega > 1.f && fabsf(dist) + prevRadius < stepLength)
+        {
+            stepLength -= omega * stepLength;
+            omega = 1.f;
+        }
+        else if(dist <= 0.f)
+        {
+            r.hit = true;
+            break;
+        }
+        else
+        {
+            stepLength = std::max(dist, 0.003f*r.t) * omega;
+
+            // back to the pyramid once steps get as large as its finest cells
+            if(dist*size[0] >= 2.f)
+                level = std::min(1, top);
+        }
+        prevRadius = fabsf(dist);
+        r.t += stepLength;
+    }
+    return r;
+}
+
+// Marches a cone around the ray o + t*d whose radius grows by 'spread' per
+// unit of t, so that it contains the rays of a block of pixels: any of them
+// is at most spread*t away from o + t*d. Steps by the distance minus the
+// cone radius, which leaves every ray of the cone in the unbounding sphere,
+// and stops where the cone (nearly) touches a surface. The returned t is a
+// start distance for all rays of the cone; r.hit is not set.
+template<class VOLUME>
+TraceResult coneTrace(const VOLUME& volume, const Vec3f& o, const Vec3f& d, float spread, float maxT)
+{
+    TraceResult r;
+    while(r.t < maxT)
+    {
+        Vec3f p = o + d * r.t;
+        if(p[1] > 1.f && d[1] > 0.f)
+            break;
+        float dist = sampleBSpline(volume, p);
+        ++r.steps;
+
+        // steps shrink towards zero as the cone approaches a surface; stop
+        // below the minimum step of the march loops
+        float step = dist - spread * r.t;
+        if(step <= 0.003f*r.t)
+            break;
+        r.t += step;
+    }
+    r.t = std::min(r.t, maxT);
+    return r;
+}
+
+#endif
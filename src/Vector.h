@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
+#include <ostream>
+#include <math.h>
 #include <stdint.h>
 
 template<typename TYPE, int N>
@@ -141,7 +144,7 @@ public:
         return *this;
     }
 
-    VTYPE cross(const VTYPE& x);
+    VTYPE cross(const VTYPE& x) const;
     
     VTYPE operator-() const
     {
@@ -229,7 +232,7 @@ typedef Vector<double, 3> Vec3d;
 typedef Vector<double, 4> Vec4d;
 
 template<>
-inline Vector<float, 3> Vector<float, 3>::cross(const Vector<float, 3>& x)
+inline Vector<float, 3> Vector<float, 3>::cross(const Vector<float, 3>& x) const
 {
     return Vector<float, 3>(v[1]*x[2] - v[2]*x[1],
                             v[2]*x[0] - v[0]*x[2],
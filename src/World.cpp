@@ -1,14 +1,223 @@
 #include "World.h"
+#include "BrickedVolume.h"
 #include <cassert>
 #include "noise.h"
-#include "Timer.h"
+#include "Profiler.h"
 #include <iostream>
+#include <limits>
+#include <string.h>
+#include <stdlib.h>
 
 int DEFAULT_WORLD_WIDTH = 256;
 int DEFAULT_WORLD_HEIGHT = 256;
 int DEFAULT_WORLD_DEPTH = 256;
 
-PerlinNoise<256> gPerlin(42);
+extern const unsigned int WORLD_SEED = 42;
+extern const char* const WORLD_GENERATOR_VERSION = "density-v1";
+extern const int MIN_WORLD_SIZE = 8;
+
+PerlinNoise<256> gPerlin(WORLD_SEED);
+
+extern const DensityOctave DENSITY_OCTAVES[] =
+{
+    { 128.f, 2.5f },
+    {  64.f, 2.5f },
+    {  32.f, 5.f },
+    {   6.f, 70.f },
+    {   4.f, 100.f },
+    {   2.f, 100.f },
+    {   1.f, 100.f },
+};
+
+extern const int DENSITY_OCTAVE_COUNT = sizeof(DENSITY_OCTAVES) / sizeof(DENSITY_OCTAVES[0]);
+
+// Octaves with at most this many periods per world may be sampled coarsely.
+const float LOW_OCTAVE_MAX_SCALE = 6.f;
+
+// Largest second derivative of the noise along one axis (11.6, measured
+// over 2M random points), rounded up.
+const float NOISE_MAX_CURVATURE = 12.f;
+
+// One density octave sampled every 'spacing' voxels (amplitude included).
+// Reconstructs values in between by trilinear interpolation.
+struct CoarseOctave
+{
+    CoarseOctave()
+        : spacing(0), nx(0), ny(0), nz(0)
+    {}
+
+    int spacing;
+    int nx;
+    int ny;
+    int nz;
+
+    float at(int i, int j, int k) const
+    {
+        return samples[(k*ny + j)*nx + i];
+    }
+
+    // Interpolates along y and z for lattice column i.
+    float column(int i, int j, int k, float fy, float fz) const
+    {
+        float a = at(i, j, k) + fy * (at(i, j+1, k) - at(i, j, k));
+        float b = at(i, j, k+1) + fy * (at(i, j+1, k+1) - at(i, j, k+1));
+        return a + fz * (b - a);
+    }
+
+    // Position in voxels.
+    float operator()(float x, float y, float z) const
+    {
+        int i, j, k;
+        float fx = cell(x, nx, i), fy = cell(y, ny, j), fz = cell(z, nz, k);
+
+        float a = column(i, j, k, fy, fz);
+        float b = column(i+1, j, k, fy, fz);
+        return a + fx * (b - a);
+    }
+
+    // Adds the octave to the density of row (0..w-1, y, z).
+    void addRow(int y, int z, int w, float* density, std::vector<float>& scratch) const
+    {
+        int j, k;
+        float fy = cell((float)y, ny, j), fz = cell((float)z, nz, k);
+
+        scratch.resize(nx);
+        for(int i=0; i<nx; ++i)
+            scratch[i] = column(i, j, k, fy, fz);
+
+        for(int x=0; x<w; ++x)
+        {
+            int i = std::min(x / spacing, nx-2);
+            float fx = (float)(x - i*spacing) / spacing;
+            density[x] += scratch[i] + fx * (scratch[i+1] - scratch[i]);
+        }
+    }
+
+    float cell(float p, int n, int& i) const
+    {
+        i = std::min((int)(p / spacing), n-2);
+        return (p - i*spacing) / spacing;
+    }
+
+    std::vector<float> samples;
+};
+
+// Coarse octaves used by the density function, indexed like
+// DENSITY_OCTAVES. Empty, or a spacing of 0, means exact evaluation.
+std::vector<CoarseOctave> gCoarseOctaves;
+
+const CoarseOctave* coarseOctave(int i)
+{
+    if(gCoarseOctaves.empty() || gCoarseOctaves[i].spacing == 0)
+        return nullptr;
+    return &gCoarseOctaves[i];
+}
+
+WorldParams::WorldParams()
+    : width(DEFAULT_WORLD_WIDTH),
+      height(DEFAULT_WORLD_HEIGHT),
+      depth(DEFAULT_WORLD_DEPTH),
+      engine(DistanceEngine::VDT),
+      layout(VolumeLayout::Linear),
+      octaveErrorBound(DENSITY_OCTAVE_COUNT, 0.f),
+      verifyDensity(false)
+{
+}
+
+const char* const WORLD_OPTIONS_HELP =
+    "  --world-size=<n>     Size of the world in voxels along each axis, at least 8 (default: 256)\n"
+    "  --engine=vdt|edt     Distance transform used to build the world (default: vdt)\n"
+    "  --density-error=<e>  Interpolate the low-frequency density octaves (scales 6, 4, 2\n"
+    "                       and 1) from a coarse lattice, with an error bound of e >= 0\n"
+    "                       voxels per octave (0: exact)\n"
+    "  --density-error=<s>:<e>[,<s>:<e>...]  Error bound e of the low octave of scale s\n"
+    "                       only, e.g. 6:0.5,4:0.25 (others keep their bound)\n"
+    "  --verify-density     Report the deviation of the coarse density from the exact one\n"
+    "  --layout=linear|bricked  Memory layout of the VDT sweeps (default: linear)\n";
+
+bool WorldParams::parseOption(const char* arg)
+{
+    if(!strncmp(arg, "--world-size=", 13))
+    {
+        int size = atoi(arg + 13);
+        if(size < MIN_WORLD_SIZE)
+            return false;
+        width = height = depth = size;
+    }
+    else if(!strcmp(arg, "--engine=vdt"))
+        engine = DistanceEngine::VDT;
+    else if(!strcmp(arg, "--engine=edt"))
+        engine = DistanceEngine::SeparableEDT;
+    else if(!strncmp(arg, "--density-error=", 16))
+        return parseErrorBounds(arg + 16);
+    else if(!strcmp(arg, "--verify-density"))
+        verifyDensity = true;
+    else if(!strcmp(arg, "--layout=linear"))
+        layout = VolumeLayout::Linear;
+    else if(!strcmp(arg, "--layout=bricked"))
+        layout = VolumeLayout::Bricked;
+    else
+        return false;
+    return true;
+}
+
+void WorldParams::setLowOctaveErrorBound(float bound)
+{
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        if(DENSITY_OCTAVES[i].scale <= LOW_OCTAVE_MAX_SCALE)
+            octaveErrorBound[i] = bound;
+    }
+}
+
+// Parses a non-negative float that ends at one of the characters of 'ends'.
+static bool parseBound(const char*& s, const char* ends, float& value)
+{
+    char* end;
+    value = strtof(s, &end);
+    if(end == s || !strchr(ends, *end) || !(value >= 0.f))
+        return false;
+    s = end;
+    return true;
+}
+
+bool WorldParams::parseErrorBounds(const char* spec)
+{
+    float bound;
+    const char* s = spec;
+    if(!strchr(spec, ':'))
+    {
+        if(!parseBound(s, "", bound))
+            return false;
+        setLowOctaveErrorBound(bound);
+        return true;
+    }
+
+    // <scale>:<bound> pairs, applied only if all of them are valid
+    std::vector<float> bounds = octaveErrorBound;
+    for(;;)
+    {
+        float scale;
+        if(!parseBound(s, ":", scale) || *s != ':' || !parseBound(++s, ",", bound))
+            return false;
+
+        int octave = -1;
+        for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+        {
+            if(DENSITY_OCTAVES[i].scale == scale && scale <= LOW_OCTAVE_MAX_SCALE)
+                octave = i;
+        }
+        if(octave < 0)
+            return false;
+        bounds[octave] = bound;
+
+        if(!*s)
+            break;
+        ++s;
+    }
+    octaveErrorBound = bounds;
+    return true;
+}
 
 struct VectorDistanceFieldFloat
 {
@@ -43,6 +252,37 @@ struct VectorDistanceFieldFloat
     std::vector<Vec3f> data;
 };
 
+// One bit per voxel, set for solid voxels. Rows are padded to whole words
+// so that rows can be written from different threads.
+struct OccupancyVolume
+{
+    OccupancyVolume(int w, int h, int d)
+        : width(w), height(h), depth(d), rowWords((w+63)/64), bits(rowWords*h*d)
+    {}
+
+    int width;
+    int height;
+    int depth;
+    int rowWords;
+
+    bool at(int x, int y, int z) const
+    {
+        return (bits[(z*height + y)*rowWords + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    bool at(const Vec3i& pos) const
+    {
+        return at(pos[0], pos[1], pos[2]);
+    }
+
+    uint64_t* row(int y, int z)
+    {
+        return &bits[(z*height + y)*rowWords];
+    }
+
+    std::vector<uint64_t> bits;
+};
+
 template<class T>
 T clamp(const T& x, const T& l, const T& u)
 {
@@ -56,13 +296,14 @@ bool isSolid(float x, float y, float z, int w, int h, int d)
     float zz = clamp<float>(z, 0, d-1);
 
     float density = y-80.f;
-    density += gPerlin(128.f*x/w, 128.f*y/h, 128.f*z/d) * 2.5f;
-    density += gPerlin(64.f*x/w, 64.f*y/h, 64.f*z/d) * 2.5f;
-    density += gPerlin(32.f*x/w, 32.f*y/h, 32.f*z/d) * 5.f;
-    density += gPerlin(6.f*x/w, 6.f*y/h, 6.f*z/d) * 70.f;
-    density += gPerlin(4.f*x/w, 4.f*y/h, 4.f*z/d) * 100.f;
-    density += gPerlin(2.f*x/w, 2.f*y/h, 2.f*z/d) * 100.f;
-    density += gPerlin(1.f*x/w, 1.f*y/h, 1.f*z/d) * 100.f;
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        const DensityOctave& o = DENSITY_OCTAVES[i];
+        if(const CoarseOctave* coarse = coarseOctave(i))
+            density += (*coarse)(x, y, z);
+        else
+            density += gPerlin(o.scale*x/w, o.scale*y/h, o.scale*z/d) * o.amplitude;
+    }
 
     bool solid = density < 0.f;
     
@@ -74,15 +315,249 @@ bool isSolid(const Vec3f& point, int w, int h, int d)
     return isSolid(point[0], point[1], point[2], w, h, d);
 }
 
-bool isSolid(const Vec3i& point, int w, int h, int d)
+// Scratch buffers for evaluating the density of a whole row at once.
+struct DensityRow
 {
-    return isSolid(point[0], point[1], point[2], w, h, d);
+    DensityRow(int w)
+        : x(w), y(w), z(w), noise(w), density(w)
+    {}
+
+    std::vector<float> x, y, z, noise, density, coarse;
+};
+
+// Evaluates octave o at the n points (x0 + i*step, y, z) into row.noise.
+void evalOctaveRow(DensityRow& row, const DensityOctave& o, int x0, int step, int n, int y, int z, int w, int h, int d)
+{
+    float ny = o.scale*(float)y/h, nz = o.scale*(float)z/d;
+    for(int i=0; i<n; ++i)
+    {
+        row.x[i] = o.scale*(float)(x0 + i*step)/w;
+        row.y[i] = ny;
+        row.z[i] = nz;
+    }
+
+    gPerlin(row.x.data(), row.y.data(), row.z.data(), row.noise.data(), n);
+}
+
+// Same as the density in isSolid() for all voxels (0..w-1, y, z), but
+// hands every octave to the batched noise evaluation. With 'exact' the
+// coarse octaves are ignored.
+void evalDensityRow(DensityRow& row, int y, int z, int w, int h, int d, bool exact = false)
+{
+    std::fill(row.density.begin(), row.density.end(), (float)y-80.f);
+
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        const DensityOctave& o = DENSITY_OCTAVES[i];
+
+        const CoarseOctave* coarse = exact ? nullptr : coarseOctave(i);
+        if(coarse)
+        {
+            coarse->addRow(y, z, w, row.density.data(), row.coarse);
+        }
+        else
+        {
+            evalOctaveRow(row, o, 0, 1, w, y, z, w, h, d);
+
+            for(int x=0; x<w; ++x)
+                row.density[x] += row.noise[x] * o.amplitude;
+        }
+    }
+}
+
+// Lattice spacing (in voxels) for which trilinear interpolation of the
+// octave stays within errorBound: |f - If| <= h^2/8 * (|fxx|+|fyy|+|fzz|).
+int coarseSpacing(const DensityOctave& o, float errorBound, int w, int h, int d)
+{
+    float curvature = o.amplitude * NOISE_MAX_CURVATURE * o.scale*o.scale * (1.f/(w*w) + 1.f/(h*h) + 1.f/(d*d));
+    return (int)sqrtf(8.f * errorBound / curvature);
+}
+
+// Samples the octaves that have an error bound on coarse lattices. Octaves
+// whose spacing would drop below 2 voxels stay exact.
+std::vector<CoarseOctave> buildCoarseOctaves(const WorldParams& params, WorldStageTimes* times)
+{
+    int w = params.width, h = params.height, d = params.depth;
+
+    std::vector<CoarseOctave> octaves(DENSITY_OCTAVE_COUNT);
+
+    bool any = false;
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        if(params.octaveErrorBound[i] <= 0.f)
+            continue;
+
+        int spacing = coarseSpacing(DENSITY_OCTAVES[i], params.octaveErrorBound[i], w, h, d);
+        if(spacing >= 2)
+        {
+            octaves[i].spacing = spacing;
+            any = true;
+        }
+    }
+
+    if(!any)
+        return std::vector<CoarseOctave>();
+
+    std::cout << "Coarse density (";
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        if(octaves[i].spacing)
+            std::cout << " " << DENSITY_OCTAVES[i].scale << "/world:" << octaves[i].spacing;
+    }
+    std::cout << " )..." << std::flush;
+    ProfileZone zone("coarse density");
+
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        const DensityOctave& o = DENSITY_OCTAVES[i];
+        CoarseOctave& c = octaves[i];
+        if(!c.spacing)
+            continue;
+
+        int spacing = c.spacing;
+        c.nx = (w-2) / spacing + 2;
+        c.ny = (h-2) / spacing + 2;
+        c.nz = (d-2) / spacing + 2;
+        c.samples.resize(c.nx * c.ny * c.nz);
+
+#pragma omp parallel
+        {
+            ProfileZone rows("coarse density rows");
+            DensityRow row(c.nx);
+
+#pragma omp for nowait
+            for(int k=0; k<c.nz; ++k)
+            {
+                for(int j=0; j<c.ny; ++j)
+                {
+                    evalOctaveRow(row, o, 0, spacing, c.nx, j*spacing, k*spacing, w, h, d);
+
+                    for(int ii=0; ii<c.nx; ++ii)
+                        c.samples[(k*c.ny + j)*c.nx + ii] = row.noise[ii] * o.amplitude;
+                }
+            }
+        }
+    }
+    double seconds = zone.stop();
+    if(times)
+        times->add("coarse density", seconds);
+
+    return octaves;
+}
+
+// Prints the largest deviation of every coarse octave and of the total
+// density from the exact evaluation, and how many voxels changed sides.
+void verifyCoarseDensity(int w, int h, int d)
+{
+    std::vector<float> maxError(DENSITY_OCTAVE_COUNT, 0.f);
+    float maxDensityError = 0.f;
+    long long flipped = 0;
+
+#pragma omp parallel
+    {
+        DensityRow exact(w), approx(w);
+        std::vector<float> threadMaxError(DENSITY_OCTAVE_COUNT, 0.f);
+        float threadMaxDensityError = 0.f;
+        long long threadFlipped = 0;
+
+#pragma omp for
+        for(int z=0; z<d; ++z)
+        {
+            for(int y=0; y<h; ++y)
+            {
+                for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+                {
+                    const CoarseOctave* coarse = coarseOctave(i);
+                    if(!coarse)
+                        continue;
+
+                    evalOctaveRow(exact, DENSITY_OCTAVES[i], 0, 1, w, y, z, w, h, d);
+                    std::fill(approx.density.begin(), approx.density.end(), 0.f);
+                    coarse->addRow(y, z, w, approx.density.data(), approx.coarse);
+
+                    for(int x=0; x<w; ++x)
+                    {
+                        float e = fabsf(exact.noise[x] * DENSITY_OCTAVES[i].amplitude - approx.density[x]);
+                        threadMaxError[i] = std::max(threadMaxError[i], e);
+                    }
+                }
+
+                evalDensityRow(exact, y, z, w, h, d, true);
+                evalDensityRow(approx, y, z, w, h, d);
+
+                for(int x=0; x<w; ++x)
+                {
+                    threadMaxDensityError = std::max(threadMaxDensityError, fabsf(exact.density[x] - approx.density[x]));
+                    if((exact.density[x] < 0.f) != (approx.density[x] < 0.f))
+                        ++threadFlipped;
+                }
+            }
+        }
+
+#pragma omp critical
+        {
+            for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+                maxError[i] = std::max(maxError[i], threadMaxError[i]);
+            maxDensityError = std::max(maxDensityError, threadMaxDensityError);
+            flipped += threadFlipped;
+        }
+    }
+
+    std::cout << "Coarse density deviation from exact:\n";
+    for(int i=0; i<DENSITY_OCTAVE_COUNT; ++i)
+    {
+        if(const CoarseOctave* coarse = coarseOctave(i))
+        {
+            std::cout << "  octave " << DENSITY_OCTAVES[i].scale << "/world (every " << coarse->spacing
+                      << " voxels): max " << maxError[i] << "\n";
+        }
+    }
+    std::cout << "  density: max " << maxDensityError << ", " << flipped << " voxels changed occupancy\n";
+}
+
+// Evaluates isSolid() once per voxel, a row at a time.
+OccupancyVolume buildOccupancy(int w, int h, int d, WorldStageTimes* times)
+{
+    std::cout << "Occupancy..." << std::flush;
+    ProfileZone zone("occupancy");
+
+    OccupancyVolume occupancy(w, h, d);
+
+#pragma omp parallel
+    {
+        ProfileZone rows("occupancy rows");
+        DensityRow densityRow(w);
+
+#pragma omp for nowait
+        for(int z=0; z<d; ++z)
+        {
+            for(int y=0; y<h; ++y)
+            {
+                uint64_t* row = occupancy.row(y, z);
+
+                evalDensityRow(densityRow, y, z, w, h, d);
+
+                for(int x=0; x<w; ++x)
+                {
+                    if(densityRow.density[x] < 0.f)
+                        row[x >> 6] |= uint64_t(1) << (x & 63);
+                }
+            }
+        }
+    }
+    double seconds = zone.stop();
+    if(times)
+        times->add("occupancy", seconds);
+
+    return occupancy;
 }
 
-bool findBorder(const Vec3i& point, const Vec3i& delta, int w, int h, int d, float& pos)
+bool findBorder(const Vec3i& point, const Vec3i& delta, const OccupancyVolume& occupancy, float& pos)
 {
-    bool b0 = isSolid(point, w, h, d);
-    bool b1 = isSolid(point+delta, w, h, d);
+    int w = occupancy.width, h = occupancy.height, d = occupancy.depth;
+
+    bool b0 = occupancy.at(point);
+    bool b1 = occupancy.at(point+delta);
     if(b0 != b1)
     {
         Vec3f pointf(point[0], point[1], point[2]);
@@ -129,7 +604,8 @@ void minVec(Vec3f& dest, const Vec3f& other)
     }
 }
 
-Vec3f minVecBounded(VectorDistanceFieldFloat& vdf, const Vec3i& bounds, const Vec3i& coords, const Vec3f& delta)
+template<class FIELD>
+Vec3f minVecBounded(FIELD& vdf, const Vec3i& bounds, const Vec3i& coords, const Vec3f& delta)
 {
     int w = bounds[0];
     int h = bounds[1];
@@ -168,7 +644,8 @@ Vec3f minVecBounded(VectorDistanceFieldFloat& vdf, const Vec3i& bounds, const Ve
     }
 }
 
-void scan(VectorDistanceFieldFloat& vdf, const Vec3i& delta)
+template<class FIELD>
+void scan(FIELD& vdf, const OccupancyVolume& occupancy, const Vec3i& delta)
 {
     int sx = delta[0] < 0 ? -delta[0] : 0;
     int ex = delta[0] > 0 ? vdf.width - delta[0] : vdf.width;
@@ -177,67 +654,100 @@ void scan(VectorDistanceFieldFloat& vdf, const Vec3i& delta)
     int sz = delta[2] < 0 ? -delta[2] : 0;
     int ez = delta[2] > 0 ? vdf.depth - delta[2] : vdf.depth;
 
-#pragma omp parallel for
-    for(int z=sz; z<ez; ++z)
+#pragma omp parallel
     {
-        for(int y=sy; y<ey; ++y)
+        ProfileZone slices("scan slices");
+
+#pragma omp for nowait
+        for(int z=sz; z<ez; ++z)
         {
-            for(int x=sx; x<ex; ++x)
+            for(int y=sy; y<ey; ++y)
             {
-                float borderPos;
-                Vec3i pos(x,y,z);
-                if(findBorder(pos, delta, vdf.width, vdf.height, vdf.depth, borderPos))
+                for(int x=sx; x<ex; ++x)
                 {
-                    Vec3f deltaf(delta[0], delta[1], delta[2]);
-                    minVec(vdf.at(pos), deltaf * borderPos);
-                    minVec(vdf.at(pos+delta), deltaf * /*(-1)**/(1-borderPos));
+                    float borderPos;
+                    Vec3i pos(x,y,z);
+                    if(findBorder(pos, delta, occupancy, borderPos))
+                    {
+                        Vec3f deltaf(delta[0], delta[1], delta[2]);
+                        minVec(vdf.at(pos), deltaf * borderPos);
+                        minVec(vdf.at(pos+delta), deltaf * /*(-1)**/(1-borderPos));
+                    }
                 }
             }
         }
     }
 }
 
-VectorDistanceFieldFloat initVDT(int width, int height, int depth)
+// Directions of the border scans of initVDT().
+const int SCAN_COUNT = 7;
+const Vec3i SCAN_DELTAS[SCAN_COUNT] =
+{
+    Vec3i(1, 0, 0), Vec3i(0, 1, 0), Vec3i(0, 0, 1),
+    Vec3i(1, 1, 0), Vec3i(-1, 1, 0), Vec3i(0, 1, 1), Vec3i(0, -1, 1)
+};
+const char* const SCAN_STAGES[SCAN_COUNT] =
+{
+    "scan (1,0,0)", "scan (0,1,0)", "scan (0,0,1)",
+    "scan (1,1,0)", "scan (-1,1,0)", "scan (0,1,1)", "scan (0,-1,1)"
+};
+
+// FIELD is a VectorDistanceFieldFloat or a BrickedVolume<Vec3f> of the
+// occupancy's size.
+template<class FIELD>
+void initVDT(FIELD& vectorDistanceField, const OccupancyVolume& occupancy, WorldStageTimes* times)
 {
-    VectorDistanceFieldFloat vectorDistanceField(width,height,depth);
     std::fill(vectorDistanceField.data.begin(), vectorDistanceField.data.end(), Vec3f(999999.f,999999.f,999999.f));
 
     std::cout << "Init VDT... " << std::flush;
-    Timer t;
+    ProfileZone zone("init VDT");
 
-    scan(vectorDistanceField, Vec3i(1, 0, 0));    std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(0, 1, 0));    std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(0, 0, 1));    std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(1, 1, 0));    std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(-1, 1, 0));   std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(0, 1, 1));    std::cout << "." << std::flush;
-    scan(vectorDistanceField, Vec3i(0, -1, 1));   std::cout << "." << std::flush;
-
-    t.stop();
+    for(int i=0; i<SCAN_COUNT; ++i)
+    {
+        ProfileZone scanZone(SCAN_STAGES[i]);
+        scan(vectorDistanceField, occupancy, SCAN_DELTAS[i]);
+        double seconds = scanZone.end();
+        if(times)
+            times->add(SCAN_STAGES[i], seconds);
+        std::cout << "." << std::flush;
+    }
 
-    return vectorDistanceField;
+    zone.stop();
 }
 
-DistanceField VDT(VectorDistanceFieldFloat& vectorDistanceField)
+// Number of columns per work item of the parallel y sweeps in VDT().
+const int VDT_COLUMN_BLOCK = 16;
+
+// Both passes visit the slices in order and, within a slice, sweep x
+// forward and backward row by row before the final y sweep. Every row
+// starts from the last cell written by the row before it, and every slice
+// starts from row 0 of the previous slice, which the y sweep finalises
+// last. The x sweeps therefore form a single dependency chain and stay
+// serial; only the y sweeps (and the conversion) run in parallel. The
+// order of updates per voxel is unchanged, so the result is bit-identical
+// to the serial sweep.
+//
+// Of the 5 minVecBounded() updates per voxel and pass only the y sweep's
+// one is parallel, so by Amdahl's law the passes cannot get faster than
+// 1 / (4/5) = 1.25x on any number of threads. --engine=edt is the
+// transform that scales with the thread count.
+template<class FIELD>
+DistanceField VDT(FIELD& vectorDistanceField, const OccupancyVolume& occupancy, WorldStageTimes* times)
 {
     int w = vectorDistanceField.width, h = vectorDistanceField.height, d = vectorDistanceField.depth;
     Vec3i bounds(w, h, d);
 
     std::cout << "VDT: forward..." << std::flush;
-    Timer t;
+    ProfileZone forward("VDT forward");
 
     // forward pass
     for(int z=0; z<d; ++z)
     {
-        auto slice = vectorDistanceField.data.begin() + z*w*h;
-
         for(int y=0; y<h; ++y)
         {
-            auto row = slice + y*w;
-
             for(int x=0; x<w; ++x)
             {
-                Vec3f& L = *(row + x);
+                Vec3f& L = vectorDistanceField.at(x, y, z);
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(-1.f, 0, 0));
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, -1.f, 0));
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, 0, -1.f));
@@ -245,39 +755,43 @@ DistanceField VDT(VectorDistanceFieldFloat& vectorDistanceField)
 
             for(int x=w-1; x>=0; --x)
             {
-                Vec3f& L = *(row + x);
+                Vec3f& L = vectorDistanceField.at(x, y, z);
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(1.f, 0, 0));
             }
         }
 
-        for(int y=h-1; y>=0; --y)
+        // The y sweep only propagates along columns, so blocks of columns
+        // are independent of each other.
+#pragma omp parallel for schedule(static)
+        for(int xb=0; xb<w; xb+=VDT_COLUMN_BLOCK)
         {
-            auto row = slice + y*w;
+            int xe = std::min(xb + VDT_COLUMN_BLOCK, w);
 
-            for(int x=w-1; x>=0; --x)
+            for(int y=h-1; y>=0; --y)
             {
-                Vec3f& L = *(row + x);
-                L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, 1.f, 0));
+                for(int x=xe-1; x>=xb; --x)
+                {
+                    Vec3f& L = vectorDistanceField.at(x, y, z);
+                    L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, 1.f, 0));
+                }
             }
         }
     }
-    t.stop();
+    double seconds = forward.stop();
+    if(times)
+        times->add("VDT forward", seconds);
 
     std::cout << "VDT: backward..." << std::flush;
-    t.start();
+    ProfileZone backward("VDT backward");
 
     // backward pass
     for(int z=d-1; z>=0; --z)
     {
-        auto slice = vectorDistanceField.data.begin() + z*w*h;
-
         for(int y=h-1; y>=0; --y)
         {
-            auto row = slice + y*w;
-
             for(int x=w-1; x>=0; --x)
             {
-                Vec3f& L = *(row + x);
+                Vec3f& L = vectorDistanceField.at(x, y, z);
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(1.f, 0, 0));
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, 1.f, 0));
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, 0, 1.f));
@@ -285,57 +799,251 @@ DistanceField VDT(VectorDistanceFieldFloat& vectorDistanceField)
 
             for(int x=0; x<w; ++x)
             {
-                Vec3f& L = *(row + x);
+                Vec3f& L = vectorDistanceField.at(x, y, z);
                 L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(-1.f, 0, 0));
             }
         }
 
-        for(int y=0; y<h; ++y)
+#pragma omp parallel for schedule(static)
+        for(int xb=0; xb<w; xb+=VDT_COLUMN_BLOCK)
         {
-            auto row = slice + y*w;
+            int xe = std::min(xb + VDT_COLUMN_BLOCK, w);
 
-            for(int x=0; x<w; ++x)
+            for(int y=0; y<h; ++y)
             {
-                Vec3f& L = *(row + x);
-                L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, -1.f, 0));
+                for(int x=xb; x<xe; ++x)
+                {
+                    Vec3f& L = vectorDistanceField.at(x, y, z);
+                    L = minVecBounded(vectorDistanceField, bounds, Vec3i(x, y, z), Vec3f(0, -1.f, 0));
+                }
             }
         }
     }
-    t.stop();
+    seconds = backward.stop();
+    if(times)
+        times->add("VDT backward", seconds);
 
     std::cout << "VDT-SDT conversion..." << std::flush;
-    t.start();
+    ProfileZone conversion("VDT-SDT conversion");
 
     DistanceField distanceField(w, h, d);
 
+#pragma omp parallel for
     for(int z=0; z<d; ++z)
     {
         auto slice = distanceField.data.begin() + z*w*h;
-        auto sliceVDF = vectorDistanceField.data.begin() + z*w*h;
 
         for(int y=0; y<h; ++y)
         {
             auto row = slice + y*w;
-            auto rowVDF = sliceVDF + y*w;
 
             for(int x=0; x<w; ++x)
             {
-                const Vec3f& v = *(rowVDF + x);
-                bool solid = isSolid(x, y, z, w, h, d);
+                Vec3f v = vectorDistanceField.at(x, y, z);
+                bool solid = occupancy.at(x, y, z);
                 Vec3f s((float)v[0] / w, (float)v[1] / h, (float)v[2] / d);
                 *(row + x) = sqrtf((float)s[0]*s[0] + s[1]*s[1] + s[2]*s[2]) * (solid ? -1 : 1);
             }
         }
     }
-    t.stop();
+    seconds = conversion.stop();
+    if(times)
+        times->add("VDT-SDT conversion", seconds);
+
+    return distanceField;
+}
+
+const float EDT_INF = 1e20f;
+
+// 1D squared distance transform of a sampled function (lower envelope of
+// parabolas, Felzenszwalb & Huttenlocher). Samples are 'spacing' apart,
+// f >= EDT_INF marks samples that are not part of the feature set.
+// v and z are scratch buffers of size n and n+1.
+void edt1D(const float* f, int n, float spacing, float* out, int* v, float* z)
+{
+    int k = -1;
+    for(int q=0; q<n; ++q)
+    {
+        if(f[q] >= EDT_INF)
+            continue;
+
+        float qs = q * spacing;
+        float s;
+        for(;;)
+        {
+            if(k < 0)
+            {
+                s = -std::numeric_limits<float>::infinity();
+                break;
+            }
+            float vs = v[k] * spacing;
+            s = ((f[q] + qs*qs) - (f[v[k]] + vs*vs)) / (2.f * (qs - vs));
+            if(s > z[k])
+                break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = std::numeric_limits<float>::infinity();
+    }
+
+    if(k < 0)
+    {
+        std::fill(out, out + n, EDT_INF);
+        return;
+    }
+
+    int j = 0;
+    for(int q=0; q<n; ++q)
+    {
+        float qs = q * spacing;
+        while(z[j+1] < qs)
+            ++j;
+        float dq = qs - v[j] * spacing;
+        out[q] = dq*dq + f[v[j]];
+    }
+}
+
+// Runs edt1D on every line of the volume along the given axis. Lines are
+// independent and processed in parallel.
+void edtPass(std::vector<float>& g, int w, int h, int d, int axis, float spacing)
+{
+    int n = axis == 0 ? w : (axis == 1 ? h : d);
+    int stride = axis == 0 ? 1 : (axis == 1 ? w : w*h);
+    int lines = w*h*d / n;
+
+#pragma omp parallel
+    {
+        ProfileZone zone("EDT lines");
+        std::vector<float> line(n), out(n), z(n+1);
+        std::vector<int> v(n);
+
+#pragma omp for nowait
+        for(int l=0; l<lines; ++l)
+        {
+            int base;
+            if(axis == 0)
+                base = (l / h)*w*h + (l % h)*w;
+            else if(axis == 1)
+                base = (l / w)*w*h + (l % w);
+            else
+                base = (l / w)*w + (l % w);
+
+            for(int i=0; i<n; ++i)
+                line[i] = g[base + i*stride];
+
+            edt1D(line.data(), n, spacing, out.data(), v.data(), z.data());
+
+            for(int i=0; i<n; ++i)
+                g[base + i*stride] = out[i];
+        }
+    }
+}
+
+// Squared distance (in normalized world units) from every voxel to the
+// nearest voxel whose occupancy equals 'feature'.
+std::vector<float> squaredEDT(const OccupancyVolume& occupancy, bool feature)
+{
+    int w = occupancy.width, h = occupancy.height, d = occupancy.depth;
+
+    std::vector<float> g(w*h*d);
+
+#pragma omp parallel for
+    for(int z=0; z<d; ++z)
+    {
+        for(int y=0; y<h; ++y)
+        {
+            for(int x=0; x<w; ++x)
+            {
+                g[z*w*h + y*w + x] = occupancy.at(x, y, z) == feature ? 0.f : EDT_INF;
+            }
+        }
+    }
+
+    edtPass(g, w, h, d, 0, 1.f / w);
+    edtPass(g, w, h, d, 1, 1.f / h);
+    edtPass(g, w, h, d, 2, 1.f / d);
+
+    return g;
+}
+
+DistanceField EDT(const OccupancyVolume& occupancy, WorldStageTimes* times)
+{
+    int w = occupancy.width, h = occupancy.height, d = occupancy.depth;
+
+    std::cout << "EDT: transform..." << std::flush;
+    ProfileZone transform("EDT transform");
+
+    auto toSolid = squaredEDT(occupancy, true);
+    auto toEmpty = squaredEDT(occupancy, false);
+    double seconds = transform.stop();
+    if(times)
+        times->add("EDT transform", seconds);
+
+    std::cout << "EDT-SDT conversion..." << std::flush;
+    ProfileZone conversion("EDT-SDT conversion");
+
+    // The surface is assumed halfway between a voxel and its nearest
+    // neighbour of the opposite kind. Unlike initVDT() the border is not
+    // refined against the density function, so both engines agree to
+    // within half a voxel.
+    float halfVoxel = 0.5f / std::max(w, std::max(h, d));
+
+    DistanceField distanceField(w, h, d);
+
+#pragma omp parallel for
+    for(int z=0; z<d; ++z)
+    {
+        for(int y=0; y<h; ++y)
+        {
+            for(int x=0; x<w; ++x)
+            {
+                int i = z*w*h + y*w + x;
+                if(occupancy.at(x, y, z))
+                    distanceField.data[i] = -(sqrtf(toEmpty[i]) - halfVoxel);
+                else
+                    distanceField.data[i] = sqrtf(toSolid[i]) - halfVoxel;
+            }
+        }
+    }
+    seconds = conversion.stop();
+    if(times)
+        times->add("EDT-SDT conversion", seconds);
 
     return distanceField;
 }
 
-DistanceField buildWorld()
+DistanceField buildWorld(const WorldParams& params, WorldStageTimes* times)
 {
-    auto vectorDistanceField = initVDT(DEFAULT_WORLD_WIDTH, DEFAULT_WORLD_HEIGHT, DEFAULT_WORLD_DEPTH);
-    auto distanceField = VDT(vectorDistanceField);
+    ProfileZone zone("build world");
+
+    gCoarseOctaves = buildCoarseOctaves(params, times);
+
+    if(params.verifyDensity && !gCoarseOctaves.empty())
+        verifyCoarseDensity(params.width, params.height, params.depth);
+
+    auto occupancy = buildOccupancy(params.width, params.height, params.depth, times);
+
+    DistanceField distanceField(0, 0, 0);
+    if(params.engine == DistanceEngine::SeparableEDT)
+    {
+        distanceField = EDT(occupancy, times);
+    }
+    else if(params.layout == VolumeLayout::Bricked)
+    {
+        BrickedVolume<Vec3f> vectorDistanceField(params.width, params.height, params.depth);
+        initVDT(vectorDistanceField, occupancy, times);
+        distanceField = VDT(vectorDistanceField, occupancy, times);
+    }
+    else
+    {
+        VectorDistanceFieldFloat vectorDistanceField(params.width, params.height, params.depth);
+        initVDT(vectorDistanceField, occupancy, times);
+        distanceField = VDT(vectorDistanceField, occupancy, times);
+    }
+
+    gCoarseOctaves.clear();
 
     return distanceField;
 }
@@ -2,8 +2,29 @@
 #define WORLD_H_
 
 #include <vector>
+#include <string>
 #include "Vector.h"
 
+// Read-only access to distance field samples stored elsewhere, e.g. in a
+// DistanceField or a memory-mapped file.
+struct DistanceFieldView
+{
+    DistanceFieldView(int w, int h, int d, const float* data)
+        : width(w), height(h), depth(d), data(data)
+    {}
+
+    int width;
+    int height;
+    int depth;
+
+    float at(int x, int y, int z) const
+    {
+        return data[z*width*height + y*width + x];
+    }
+
+    const float* data;
+};
+
 struct DistanceField
 {
     DistanceField(int w, int h, int d)
@@ -24,9 +45,98 @@ struct DistanceField
         return data[z*width*height + y*width + x];
     }
 
+    DistanceFieldView view() const
+    {
+        return DistanceFieldView(width, height, depth, data.data());
+    }
+
     std::vector<float> data;
 };
 
-DistanceField buildWorld();
+struct DensityOctave
+{
+    float scale;        // noise periods per world
+    float amplitude;
+};
+
+// Terms of the density function, in the order they are summed.
+extern const DensityOctave DENSITY_OCTAVES[];
+extern const int DENSITY_OCTAVE_COUNT;
+
+extern const unsigned int WORLD_SEED;
+
+// Changes whenever the generator produces different output for the same
+// parameters; invalidates cached worlds.
+extern const char* const WORLD_GENERATOR_VERSION;
+
+// Smallest world size along each axis: one 8^3 brick of the bricked layout
+// and the sparse world.
+extern const int MIN_WORLD_SIZE;
+
+enum class DistanceEngine
+{
+    VDT,            // vector distance transform (propagation sweeps)
+    SeparableEDT    // exact euclidean distance transform (separable 1D passes)
+};
+
+enum class VolumeLayout
+{
+    Linear,         // z*width*height + y*width + x
+    Bricked         // 8^3 bricks (BrickedVolume), used for the VDT sweeps
+};
+
+struct WorldParams
+{
+    WorldParams();
+
+    // Applies a command line option (see WORLD_OPTIONS_HELP). Returns false
+    // if arg is not a world option.
+    bool parseOption(const char* arg);
+
+    // Sets the error bound of the low-frequency density octaves (up to 6
+    // periods per world) and leaves the others exact.
+    void setLowOctaveErrorBound(float bound);
+
+    // Sets the error bounds of a --density-error option: one bound for all
+    // low octaves, or <scale>:<bound> pairs for single low octaves. Returns
+    // false, changing nothing, on a negative bound, a scale that is not a
+    // low octave or a malformed list.
+    bool parseErrorBounds(const char* spec);
+
+    int width;
+    int height;
+    int depth;
+
+    DistanceEngine engine;
+    VolumeLayout layout;
+
+    // Interpolation error bound per density octave, in density units (one
+    // unit is one voxel along y). Octaves with a positive bound are sampled
+    // on a coarse lattice and interpolated; 0 evaluates the octave at every
+    // voxel.
+    std::vector<float> octaveErrorBound;
+
+    // Compares the interpolated density with the exact one and prints the
+    // maximum deviation per octave.
+    bool verifyDensity;
+};
+
+extern const char* const WORLD_OPTIONS_HELP;
+
+// Wall clock time of the stages of buildWorld(), in the order they ran.
+struct WorldStageTimes
+{
+    void add(const char* stage, double s)
+    {
+        stages.push_back(stage);
+        seconds.push_back(s);
+    }
+
+    std::vector<std::string> stages;
+    std::vector<double> seconds;
+};
+
+// Generates the world. With times, the time of each stage is added to it.
+DistanceField buildWorld(const WorldParams& params = WorldParams(), WorldStageTimes* times = NULL);
 
 #endif
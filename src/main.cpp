@@ -3,7 +3,23 @@
 #include "GLWrapper.h"
 #include "FSUtils.h"
 #include "Matrix4x4.h"
+#include "Camera.h"
 #include "World.h"
+#include "DistanceFieldCache.h"
+#include "BrickedVolume.h"
+#include "Sampler.h"
+#include "Quantize.h"
+#include "SparseDistanceField.h"
+#include "DistancePyramid.h"
+#include "Trace.h"
+#include "ShadingVolume.h"
+#include "HeightMap.h"
+#include "Profiler.h"
+#include "RenderScale.h"
+#include "StepStats.h"
+#include "CameraPath.h"
+#include "FrameTelemetry.h"
+#include <chrono>
 
 static bool gRunning = true;
 static int gResX = 1024;
@@ -11,6 +27,38 @@ static int gResY = 768;
 static bool gFullscreen = false;
 static bool gVsync = false;
 static float gSpeed = 0.002f;
+static WorldParams gWorldParams;
+static std::string gWorldCache = "data/world.cache";
+static bool gBenchmarkSampler = false;
+static FieldEncoding gWorldEncoding = FieldEncoding::Float32;
+static float gNarrowBand = 16.f;     // in voxels
+static bool gSparseWorld = false;
+static float gSparseBand = 4.f;      // in voxels
+static bool gHierarchical = false;
+static int gPyramidLevels = 3;
+static bool gRelaxed = false;
+static float gRelaxation = 1.6f;    // omega of over-relaxed sphere tracing
+static int gPrepassScale = 0;       // block size of the cone prepass, 0 = off
+static bool gReprojection = false;
+static float gReprojectionBackoff = 0.9f;
+static bool gAnalyticNormals = true;
+static bool gBakedShading = false;
+static bool gHeightMap = false;
+static int gHeightTile = 4;         // in voxels
+static bool gDynamicResolution = false;
+static float gFrameBudget = 16.7f;      // in ms, with dynamic resolution
+static float gMinRenderScale = 0.25f;
+static std::string gProfile;
+static bool gStepHeatmap = false;
+static float gHeatmapMax = 64.f;       // iterations shown as red
+static const int STEP_STATS_INTERVAL = 60;  // frames between step statistics
+static std::string gRecordPath;
+static std::string gPlayPath;
+static std::string gPathTimes;
+static CameraPath gCameraPath;       // recorded or played
+static FrameTelemetry gTelemetry;
+static std::string gFrameTimesCsv;
+static const double TITLE_INTERVAL = 0.5;  // seconds between window title updates
 
 static const int EVENT_RELOADSHADERCODE = 0;
 
@@ -35,89 +83,266 @@ struct Resources
     ElementArrayBuffer elementBuffer;
 
     Texture3D worldTex;
+    Texture3D pageTex;
+    Texture3D atlasTex;
+    Texture3D pyramidTex;
+    Texture3D shadingTex;
+    Texture2D heightTex;
     Texture1D hgTex;
     Texture2D debugImgTex;
 
+    // start distances of the cone prepass, one texel per block
+    Framebuffer prepassFbo;
+    Texture2D prepassTex;
+    int prepassScale;
+
+    // temporal reprojection: the frame is rendered into frameFbo, with the
+    // hit distance of each pixel in hitTex, and copied to the window. The
+    // next frame splats the end points into reprojTex. frameFbo also holds
+    // frames rendered below window resolution, and the march loop
+    // iterations and distance samples of each pixel in stepTex.
+    VertexShader reprojectVs;
+    FragmentShader reprojectFs;
+    Program reprojectProgram;
+    Framebuffer frameFbo;
+    Texture2D frameColorTex;
+    Texture2D hitTex;
+    Texture2D stepTex;
+    int stepStatsFrame;
+    Framebuffer reprojFbo;
+    Texture2D reprojTex;
+    bool historyValid;
+    Vec3f prevCameraPos, prevCameraUp, prevCameraDir;
+
+    bool hasShadingVolume;
+
+    // per-tile max height map; tile size and top are normalized
+    bool hasHeightMap;
+    Vec2f heightTileSize;
+    float heightTop;
+
+    // dynamic resolution: frames are rendered at renderWidth x renderHeight
+    // and scaled to the window
+    RenderScaleController renderScale;
+    int renderWidth, renderHeight;
+
+    // GPU time of the frames, for the telemetry and dynamic resolution.
+    // Several timer queries are in flight, since their results arrive
+    // frames later.
+    bool timerQueries;
+    TimerQuery frameQueries[4];
+    int frameQueryFrame[4];         // telemetry frame of the query, -1 = no result pending
+    float frameQueryScale[4];       // render scale of the timed frame, 0 = not for dynamic resolution
+    int frameIndex;
+    std::chrono::steady_clock::time_point frameStart;
+
     Vec3i worldSize;
+    float worldScale;
+    Vec3i atlasSlots;
+
+    // the world on the CPU, mapped from the cache or as generated, for the
+    // pyramid, which is only built once hierarchical marching is used
+    MappedDistanceField worldCache;
+    DistanceField worldField{0, 0, 0};
+    bool hasPyramid;
+    int pyramidLevels;
 } gResources;
 
-struct Camera
+DistanceFieldView WorldView()
 {
-    Camera(const Vec3f& pos, const Vec3f& up, const Vec3f& dir, float fovy, int screenWidth, int screenHeight)
-        : pos(pos),
-          up(up),
-          dir(dir)
-    {
-        float focalLength = 1.f;
+    return gResources.worldCache.isOpen() ? gResources.worldCache.view() : gResources.worldField.view();
+}
 
-        float aspect = (float)screenWidth / (float)screenHeight;
+Camera gCamera = defaultCamera(gResX, gResY);
 
-        float height = focalLength / (2*tan(fovy/2.f));
-        float width = aspect * height;
+// Sphere traces a grid of camera rays on the CPU through 'volume' and
+// prints the time taken, to compare memory layouts. With a pyramid, rays
+// skip empty space hierarchically; omega > 1 over-relaxes the steps.
+template<class VOLUME>
+void BenchmarkSampler(const char* name, const VOLUME& volume, const DistancePyramid* pyramid = NULL, float omega = 1.f)
+{
+    const int resX = 256, resY = 192;
+    float stepX = gCamera.stepX * gResX / resX;
+    float stepY = gCamera.stepY * gResY / resY;
 
-        stepX = width / screenWidth;
-        stepY = height / screenHeight;
-    }
+    std::cout << "Sampler (" << name << ")..." << std::flush;
+    ProfileZone zone("sampler benchmark");
 
-    ~Camera()
+    double sum = 0.;
+    long long steps = 0, coarseSteps = 0;
+    for(int py=0; py<resY; ++py)
     {
-    }
+        for(int px=0; px<resX; ++px)
+        {
+            Vec3f d = gCamera.dir
+                    + gCamera.dir.cross(gCamera.up) * ((px - resX/2.f) * stepX)
+                    + gCamera.up * ((py - resY/2.f) * stepY);
+            d.normalize();
 
-    void moveForward(float dt)
-    {
-        pos += dir * dt * 0.25f;
+            TraceResult r = pyramid ? sphereTraceHierarchical(volume, *pyramid, gCamera.pos, d, 6.f, omega)
+                                    : sphereTrace(volume, gCamera.pos, d, 6.f, omega);
+            sum += r.t;
+            steps += r.steps;
+            coarseSteps += r.coarseSteps;
+        }
     }
+    zone.stop();
+    std::cout << "  mean hit distance " << sum / (resX*resY) << ", " << (double)steps / (resX*resY) << " steps";
+    if(pyramid)
+        std::cout << " + " << (double)coarseSteps / (resX*resY) << " pyramid lookups";
+    std::cout << " per ray\n";
+}
 
-    void moveBackward(float dt)
-    {
-        pos -= dir * dt * 0.25f;
-    }
+DistancePyramid BuildPyramid(const DistanceFieldView& distanceField)
+{
+    std::cout << "Distance pyramid (" << gPyramidLevels << " levels)..." << std::flush;
+    ProfileZone zone("distance pyramid");
+    DistancePyramid pyramid = buildDistancePyramid(distanceField, gPyramidLevels);
+    zone.stop();
+    if(pyramid.levelCount() < gPyramidLevels)
+        std::cout << "  only " << pyramid.levelCount() << " levels fit the world size\n";
+    return pyramid;
+}
 
-    void moveLeft(float dt)
-    {
-        pos -= dir.cross(up) * dt * 0.25f;
-    }
+void UploadPyramid(const DistanceFieldView& distanceField)
+{
+    DistancePyramid pyramid = BuildPyramid(distanceField);
+
+    gResources.pyramidTex.gen();
+    Texture3D::active(5);
+    gResources.pyramidTex.bind()
+        .minFilter(TextureMinFilter::NearestMipmapNearest)
+        .magFilter(TextureMagFilter::Nearest)
+        .baseLevel(0)
+        .maxLevel(std::max(0, pyramid.levelCount() - 1))
+        .generateMipMap(false);
 
-    void moveRight(float dt)
+    for(int l=1; l<=pyramid.levelCount(); ++l)
     {
-        pos += dir.cross(up) * dt * 0.25f;
+        const DistanceField& level = pyramid.levels[l-1];
+        TextureImage<const float, 3> levelImg(level.width, level.height, level.depth, level.data.data(), ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+        Texture3D::texImage(TextureTarget3D::Texture3D, l-1, Border::Zero, levelImg);
     }
 
-    void rotateX(float dt)
+    gResources.hasPyramid = true;
+    gResources.pyramidLevels = pyramid.levelCount();
+}
+
+// Bakes and uploads the normal and detail volume of baked shading.
+void UploadShadingVolume(const DistanceFieldView& distanceField)
+{
+    std::cout << "Baking shading volume..." << std::flush;
+    ProfileZone zone("bake shading volume");
+    ShadingVolume shading = bakeShadingVolume(distanceField);
+    zone.stop("  ");
+
+    gResources.shadingTex.gen();
+    Texture3D::active(10);
+    gResources.shadingTex.bind()
+        .minFilter(TextureMinFilter::Linear)
+        .magFilter(TextureMagFilter::Linear)
+        .wrapS(WrapMode::MirroredRepeat)
+        .wrapT(WrapMode::Clamp)
+        .wrapR(WrapMode::MirroredRepeat)
+        .generateMipMap(false);
+
+    TextureImage<const uint8_t, 3> texImg(shading.width, shading.height, shading.depth, shading.data.data(), ImageType::UnsignedByte, ImageFormat::RGBA, ImageInternalFormat::RGBA8);
+    Texture3D::texImage(TextureTarget3D::Texture3D, 0, Border::Zero, texImg);
+
+    gResources.hasShadingVolume = true;
+}
+
+// Builds and uploads the height map that rays skip the space above the
+// terrain with.
+void UploadHeightMap(const DistanceFieldView& distanceField)
+{
+    std::cout << "Height map (" << gHeightTile << " voxel tiles)..." << std::flush;
+    ProfileZone zone("height map");
+    HeightMap heights = buildHeightMap(distanceField, gHeightTile);
+    zone.stop();
+    if(heights.empty())
     {
-        Matrix4x4f a = Matrix4x4f::Identity()
-                       .RotateY(dt*0.01f);
-        up = a*up;
-        dir = a*dir;
+        std::cout << "  tile size " << gHeightTile << " does not divide the world size\n";
+        return;
     }
 
-    void rotateY(float dt)
+    // fetched with texelFetch, wrapping is applied to the index in the shader
+    gResources.heightTex.gen();
+    Texture2D::active(11);
+    gResources.heightTex.bind()
+        .minFilter(TextureMinFilter::Nearest)
+        .magFilter(TextureMagFilter::Nearest)
+        .generateMipMap(false);
+    TextureImage<const float, 2> heightImg(heights.width, heights.depth, heights.heights.data(), ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+    Texture2D::texImage(TextureTarget2D::Texture2D, 0, Border::Zero, heightImg);
+
+    gResources.hasHeightMap = true;
+    gResources.heightTileSize = Vec2f(heights.tileWidth, heights.tileDepth);
+    gResources.heightTop = heights.top;
+}
+
+void UploadSparseWorld(const DistanceFieldView& distanceField)
+{
+    std::cout << "Sparse world (band " << gSparseBand << " voxels)..." << std::flush;
+    ProfileZone zone("sparse world");
+    SparseDistanceField sparse = buildSparseDistanceField(distanceField, gSparseBand);
+    zone.stop();
+    std::cout << "  " << sparse.slotCount << " of " << sparse.page.size() << " bricks stored, "
+              << sparse.memorySize() / (1024*1024) << " MB instead of "
+              << (size_t)distanceField.width*distanceField.height*distanceField.depth*sizeof(float) / (1024*1024) << " MB\n";
+
+    if(gBenchmarkSampler)
+        BenchmarkSampler("sparse", sparse);
+
+    std::vector<float> page(sparse.page.size()*2);
+    for(size_t i=0; i<sparse.page.size(); ++i)
     {
-        Matrix4x4f a = Matrix4x4f::Identity()
-                       .Rotate(-dt*0.01f, dir.cross(up));
-        Vec3f newUp = a*up;
-        if(newUp.dot(Vec3f(0.f,1.f,0.f)) > 0.f)
-        {
-            up = newUp;
-            dir = a*dir;
-        }
+        page[2*i] = (float)sparse.page[i];
+        page[2*i+1] = sparse.pageValue[i];
     }
 
-    Vec3f pos;
-    Vec3f up;
-    Vec3f dir;
+    gResources.pageTex.gen();
+    Texture3D::active(3);
+    gResources.pageTex.bind()
+        .minFilter(TextureMinFilter::Nearest)
+        .magFilter(TextureMagFilter::Nearest)
+        .generateMipMap(false);
+    TextureImage<const float, 3> pageImg(sparse.bricksX, sparse.bricksY, sparse.bricksZ, page.data(), ImageType::Float, ImageFormat::RG, ImageInternalFormat::RG32F);
+    Texture3D::texImage(TextureTarget3D::Texture3D, 0, Border::Zero, pageImg);
+
+    // lookups never leave a slot, so the atlas needs no wrapping
+    gResources.atlasTex.gen();
+    Texture3D::active(4);
+    gResources.atlasTex.bind()
+        .minFilter(TextureMinFilter::Linear)
+        .magFilter(TextureMagFilter::Linear)
+        .wrapS(WrapMode::ClampToEdge)
+        .wrapT(WrapMode::ClampToEdge)
+        .wrapR(WrapMode::ClampToEdge)
+        .generateMipMap(false);
+    const int SLOT = SparseDistanceField::SLOT;
+    TextureImage<const float, 3> atlasImg(sparse.atlasX*SLOT, sparse.atlasY*SLOT, sparse.atlasZ*SLOT, sparse.atlas.data(), ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+    Texture3D::texImage(TextureTarget3D::Texture3D, 0, Border::Zero, atlasImg);
 
-    float stepX;
-    float stepY;
-} gCamera(Vec3f(0.0610065f, 0.0558378f, 0.150712f),
-          Vec3f(0.114496f, 0.966392f, -0.230176f),
-          Vec3f(0.430408f, 0.257082f, 0.865253f),
-          45.f/180.f*(float)M_PI,
-          gResX, gResY);
+    gResources.worldSize = Vec3i(distanceField.width, distanceField.height, distanceField.depth);
+    gResources.worldScale = 1.f;
+    gResources.atlasSlots = Vec3i(sparse.atlasX, sparse.atlasY, sparse.atlasZ);
+}
 
-void InitWorld()
+void UploadWorld(const DistanceFieldView& distanceField)
 {
-    auto distanceField = buildWorld();
+    if(gHierarchical)
+        UploadPyramid(distanceField);
+    if(gBakedShading)
+        UploadShadingVolume(distanceField);
+    if(gHeightMap)
+        UploadHeightMap(distanceField);
+
+    if(gSparseWorld)
+    {
+        UploadSparseWorld(distanceField);
+        return;
+    }
 
     gResources.worldTex.gen();
 
@@ -131,10 +356,93 @@ void InitWorld()
         .generateMipMap(false);
 
     gResources.worldSize = Vec3i(distanceField.width, distanceField.height, distanceField.depth);
-    TextureImage3DAlpha texImg(distanceField.width, distanceField.height, distanceField.depth, distanceField.data.data(), ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+    gResources.worldScale = 1.f;
+
+    if(gWorldEncoding == FieldEncoding::Float32)
+    {
+        TextureImage<const float, 3> texImg(distanceField.width, distanceField.height, distanceField.depth, distanceField.data, ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+        Texture3D::texImage(TextureTarget3D::Texture3D, 0, Border::Zero, texImg);
+        return;
+    }
+
+    int maxDim = std::max(distanceField.width, std::max(distanceField.height, distanceField.depth));
+
+    std::cout << "Quantizing world to " << encodingName(gWorldEncoding) << "..." << std::flush;
+    ProfileZone zone("quantize world");
+    QuantizedField q = quantize(distanceField, gWorldEncoding, gNarrowBand / maxDim);
+    zone.stop();
+
+    // errors in voxels
+    std::cout << "  max error " << q.maxError * maxDim << ", rms error " << q.rmsError * maxDim;
+    if(gWorldEncoding == FieldEncoding::NarrowBand8)
+        std::cout << " inside +-" << gNarrowBand << ", " << q.clamped << " voxels clamped";
+    std::cout << "\n";
+
+    gResources.worldScale = q.scale;
+
+    ImageType type = ImageType::HalfFloat;
+    ImageInternalFormat internalFormat = ImageInternalFormat::R16F;
+    if(gWorldEncoding == FieldEncoding::Snorm16)
+    {
+        type = ImageType::Short;
+        internalFormat = ImageInternalFormat::R16SNorm;
+    }
+    else if(gWorldEncoding == FieldEncoding::NarrowBand8)
+    {
+        type = ImageType::Byte;
+        internalFormat = ImageInternalFormat::R8SNorm;
+    }
+
+    TextureImage<const uint8_t, 3> texImg(q.width, q.height, q.depth, q.data.data(), type, ImageFormat::Red, internalFormat);
     Texture3D::texImage(TextureTarget3D::Texture3D, 0, Border::Zero, texImg);
 }
 
+void InitWorld()
+{
+    if(gBenchmarkSampler)
+    {
+        // works on a freshly generated world, so that the layout option
+        // applies to world generation as well
+        auto distanceField = buildWorld(gWorldParams);
+        BrickedDistanceField bricked(distanceField.width, distanceField.height, distanceField.depth);
+        toBricked(distanceField.data.data(), bricked);
+
+        BenchmarkSampler("linear", distanceField);
+        BenchmarkSampler("bricked", bricked);
+        if(gHierarchical)
+        {
+            DistancePyramid pyramid = BuildPyramid(distanceField.view());
+            BenchmarkSampler("linear, hierarchical", distanceField, &pyramid);
+            if(gRelaxed)
+                BenchmarkSampler("linear, hierarchical, relaxed", distanceField, &pyramid, gRelaxation);
+        }
+        if(gRelaxed)
+            BenchmarkSampler("linear, relaxed", distanceField, NULL, gRelaxation);
+
+        DistanceField linear(distanceField.width, distanceField.height, distanceField.depth);
+        toLinear(bricked, linear.data.data());
+        gResources.worldField = std::move(linear);
+        UploadWorld(WorldView());
+        return;
+    }
+
+    if(!gWorldCache.empty() && gResources.worldCache.open(gWorldCache, gWorldParams))
+    {
+        std::cout << "Loaded world from " << gWorldCache << "\n";
+        UploadWorld(WorldView());
+        return;
+    }
+
+    gResources.worldField = buildWorld(gWorldParams);
+
+    if(!gWorldCache.empty() && !saveDistanceField(gWorldCache, gResources.worldField, gWorldParams))
+        std::cout << "Could not write " << gWorldCache << "\n";
+    else if(!gWorldCache.empty() && gResources.worldCache.open(gWorldCache, gWorldParams))
+        gResources.worldField = DistanceField(0, 0, 0);     // kept mapped rather than in memory
+
+    UploadWorld(WorldView());
+}
+
 void InitShaders()
 {
     try
@@ -158,6 +466,35 @@ void InitShaders()
 
         Uniform<int>(gResources.p, "worldTex").set(0);
         Uniform<Vec3i>(gResources.p, "worldSize").set(gResources.worldSize);
+        Uniform<float>(gResources.p, "worldScale").set(gResources.worldScale);
+
+        Uniform<int>(gResources.p, "sparseWorld").set(gSparseWorld);
+        Uniform<int>(gResources.p, "pageTex").set(3);
+        Uniform<int>(gResources.p, "atlasTex").set(4);
+        Uniform<Vec3i>(gResources.p, "atlasSlots").set(gResources.atlasSlots);
+
+        Uniform<int>(gResources.p, "pyramidTex").set(5);
+
+        Uniform<int>(gResources.p, "prepassTex").set(6);
+        Uniform<int>(gResources.p, "reprojTex").set(7);
+        Uniform<int>(gResources.p, "shadingTex").set(10);
+        Uniform<int>(gResources.p, "heightTex").set(11);
+
+        gResources.reprojectVs.fromFile("data/shader/reproject.vert");
+        gResources.reprojectVs.compile();
+
+        gResources.reprojectFs.fromFile("data/shader/reproject.frag");
+        gResources.reprojectFs.compile();
+
+        gResources.reprojectProgram.create();
+        gResources.reprojectProgram.attachShader(gResources.reprojectVs);
+        gResources.reprojectProgram.attachShader(gResources.reprojectFs);
+        gResources.reprojectProgram.link();
+        gResources.reprojectProgram.use();
+
+        Uniform<float>(gResources.reprojectProgram, "screenWidth").set((float)gResX);
+        Uniform<float>(gResources.reprojectProgram, "screenHeight").set((float)gResY);
+        Uniform<int>(gResources.reprojectProgram, "hitTex").set(8);
     }
     catch(const GLCompileError& ex)
     {
@@ -165,6 +502,89 @@ void InitShaders()
     }
 }
 
+// (Re)creates the prepass target for gPrepassScale.
+void InitPrepass()
+{
+    gResources.prepassScale = gPrepassScale;
+    if(gPrepassScale <= 1)
+        return;
+
+    int width = (gResX + gPrepassScale - 1) / gPrepassScale;
+    int height = (gResY + gPrepassScale - 1) / gPrepassScale;
+
+    gResources.prepassTex.gen();
+    Texture2D::active(6);
+    gResources.prepassTex.bind()
+        .minFilter(TextureMinFilter::Nearest)
+        .magFilter(TextureMagFilter::Nearest)
+        .generateMipMap(false);
+    TextureImage<const float, 2> prepassImg(width, height, nullptr, ImageType::Float, ImageFormat::Red, ImageInternalFormat::R32F);
+    Texture2D::texImage(TextureTarget2D::Texture2D, 0, Border::Zero, prepassImg);
+
+    gResources.prepassFbo.gen();
+    gResources.prepassFbo.bind();
+    Framebuffer::attach(FramebufferAttachment::Color0, gResources.prepassTex);
+    Framebuffer::checkStatus();
+    Framebuffer::unbind();
+}
+
+static void InitRenderTarget(Texture2D& tex, int unit, ImageInternalFormat internalFormat, ImageFormat format, ImageType type)
+{
+    tex.gen();
+    Texture2D::active(unit);
+    tex.bind()
+        .minFilter(TextureMinFilter::Nearest)
+        .magFilter(TextureMagFilter::Nearest)
+        .generateMipMap(false);
+    TextureImage<const float, 2> img(gResX, gResY, nullptr, type, format, internalFormat);
+    Texture2D::texImage(TextureTarget2D::Texture2D, 0, Border::Zero, img);
+}
+
+void InitReprojection()
+{
+    InitRenderTarget(gResources.frameColorTex, 9, ImageInternalFormat::RGBA8, ImageFormat::RGBA, ImageType::UnsignedByte);
+    InitRenderTarget(gResources.hitTex, 8, ImageInternalFormat::R32F, ImageFormat::Red, ImageType::Float);
+    InitRenderTarget(gResources.reprojTex, 7, ImageInternalFormat::RG32F, ImageFormat::RG, ImageType::Float);
+    InitRenderTarget(gResources.stepTex, 12, ImageInternalFormat::RG32F, ImageFormat::RG, ImageType::Float);
+
+    gResources.frameFbo.gen();
+    gResources.frameFbo.bind();
+    Framebuffer::attach(FramebufferAttachment::Color0, gResources.frameColorTex);
+    Framebuffer::attach(FramebufferAttachment::Color1, gResources.hitTex);
+    Framebuffer::attach(FramebufferAttachment::Color2, gResources.stepTex);
+    Framebuffer::drawBuffers(3);
+    Framebuffer::checkStatus();
+
+    gResources.reprojFbo.gen();
+    gResources.reprojFbo.bind();
+    Framebuffer::attach(FramebufferAttachment::Color0, gResources.reprojTex);
+    Framebuffer::checkStatus();
+    Framebuffer::unbind();
+
+    gResources.historyValid = false;
+    gResources.stepStatsFrame = 0;
+}
+
+void InitFrameTiming()
+{
+    gResources.renderScale = RenderScaleController(gFrameBudget, gMinRenderScale);
+    gResources.renderWidth = gResX;
+    gResources.renderHeight = gResY;
+
+    gResources.timerQueries = TimerQuery::isSupported();
+    if(gResources.timerQueries)
+    {
+        for(TimerQuery& query : gResources.frameQueries)
+            query.gen();
+        for(int& frame : gResources.frameQueryFrame)
+            frame = -1;
+    }
+    else
+    {
+        std::cout << "No GL timer queries, no GPU frame times; dynamic resolution uses CPU frame times\n";
+    }
+}
+
 void Init(Context& gl)
 {
     gResources.vertexBuffer.gen();
@@ -177,19 +597,185 @@ void Init(Context& gl)
 
     InitWorld();
     InitShaders();
+    InitPrepass();
+    InitReprojection();
+    InitFrameTiming();
+}
+
+void DrawScreenQuad(Context& gl)
+{
+    gResources.vertexBuffer.bind();
+
+    VertexAttribArray attribPosition(gResources.p, "position");
+    attribPosition.setupPointer<Vec4f>();
+    attribPosition.enable();
+
+    gResources.elementBuffer.bind();
+    gl.drawElements(PrimitiveType::Quads, 4, IndicesType::UnsignedInt, 0);
+
+    attribPosition.disable();
+}
+
+// Splats the end points of the previous frame into reprojTex. Both frames
+// are width x height.
+void ReprojectHistory(Context& gl, int width, int height, float stepX, float stepY)
+{
+    gResources.reprojectProgram.use();
+
+    Uniform<float>(gResources.reprojectProgram, "screenWidth").set((float)width);
+    Uniform<float>(gResources.reprojectProgram, "screenHeight").set((float)height);
+    Uniform<Vec3f>(gResources.reprojectProgram, "cameraPos").set(gCamera.pos);
+    Uniform<Vec3f>(gResources.reprojectProgram, "cameraUp").set(gCamera.up);
+    Uniform<Vec3f>(gResources.reprojectProgram, "cameraDir").set(gCamera.dir);
+    Uniform<Vec3f>(gResources.reprojectProgram, "prevCameraPos").set(gResources.prevCameraPos);
+    Uniform<Vec3f>(gResources.reprojectProgram, "prevCameraUp").set(gResources.prevCameraUp);
+    Uniform<Vec3f>(gResources.reprojectProgram, "prevCameraDir").set(gResources.prevCameraDir);
+    Uniform<float>(gResources.reprojectProgram, "stepX").set(stepX);
+    Uniform<float>(gResources.reprojectProgram, "stepY").set(stepY);
+
+    // neither texture may be bound while the other pass renders to it
+    Texture2D::active(7);
+    Texture2D::unbind();
+    Texture2D::active(8);
+    gResources.hitTex.bind();
+
+    gResources.reprojFbo.bind();
+    gl.viewport(0, 0, width, height);
+    gl.clearColor(1e30f, 0.f, 0.f, 0.f);
+    gl.clear().ColorBuffer();
+    gl.enable(Capability::Blend);
+    gl.enable(Capability::VertexProgramPointSize);
+    gl.blendEquation(BlendEquation::Min);
+
+    gl.drawArrays(PrimitiveType::Points, 0, width*height);
+
+    gl.blendEquation(BlendEquation::Add);
+    gl.disable(Capability::Blend);
+    gl.clearColor(0.f, 0.f, 0.f, 0.f);
+    Framebuffer::unbind();
+
+    Texture2D::unbind();
+    Texture2D::active(7);
+    gResources.reprojTex.bind();
+}
+
+// Starts measuring the GPU (or CPU) time of a frame rendered at scale, 0
+// for frames that are only timed for the telemetry.
+void BeginFrameTiming(float scale)
+{
+    if(!gResources.timerQueries)
+    {
+        gResources.frameStart = std::chrono::steady_clock::now();
+        return;
+    }
+
+    // collect the results that have arrived; the query reused now must be
+    // finished, which usually takes a few frames
+    const int queries = sizeof(gResources.frameQueries) / sizeof(gResources.frameQueries[0]);
+    int current = gResources.frameIndex % queries;
+    for(int i=1; i<=queries; ++i)
+    {
+        int q = (current + i) % queries;
+        if(gResources.frameQueryFrame[q] >= 0 && (q == current || gResources.frameQueries[q].isAvailable()))
+        {
+            double ms = gResources.frameQueries[q].milliseconds();
+            gTelemetry.setGpuTime(gResources.frameQueryFrame[q], ms);
+            if(gResources.frameQueryScale[q] > 0.f)
+                gResources.renderScale.update(ms, gResources.frameQueryScale[q]);
+            gResources.frameQueryFrame[q] = -1;
+        }
+    }
+
+    gResources.frameQueries[current].begin();
+    gResources.frameQueryFrame[current] = gTelemetry.frames();
+    gResources.frameQueryScale[current] = scale;
+}
+
+void EndFrameTiming(Context& gl, float scale)
+{
+    if(!gResources.timerQueries)
+    {
+        if(scale <= 0.f)
+            return;
+
+        // without queries the frame has to be finished to be timed
+        gl.finish();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gResources.frameStart).count();
+        gResources.renderScale.update(ms, scale);
+        return;
+    }
+
+    TimerQuery::end();
+    ++gResources.frameIndex;
+}
+
+// Reads the step counts of the width x height frame in frameFbo back and
+// prints their statistics. Stalls until the frame is rendered.
+void PrintStepStatistics(int width, int height)
+{
+    std::vector<GLfloat> texels(2*width*height);
+    gResources.frameFbo.readPixels(FramebufferAttachment::Color2, width, height, ImageFormat::RG, &texels[0]);
+
+    std::vector<int> iterations(width*height), samples(width*height);
+    for(int i=0; i<width*height; ++i)
+    {
+        iterations[i] = (int)texels[2*i];
+        samples[i] = (int)texels[2*i + 1];
+    }
+
+    StepStatistics it = stepStatistics(iterations);
+    StepStatistics sa = stepStatistics(samples);
+    std::cout << "Iterations per pixel: mean " << it.mean << ", p50 " << it.p50 << ", p99 " << it.p99 << ", max " << it.max
+              << "; distance samples: mean " << sa.mean << ", p50 " << sa.p50 << ", p99 " << sa.p99 << ", max " << sa.max << "\n";
 }
 
 void Render(Context& gl)
 {
+    // size of this frame: the window size, or a fraction of it that keeps
+    // the frame time budget
+    float scale = gDynamicResolution ? gResources.renderScale.scale() : 1.f;
+    int width = std::max(1, (int)(gResX * scale + 0.5f));
+    int height = std::max(1, (int)(gResY * scale + 0.5f));
+    if(width != gResources.renderWidth || height != gResources.renderHeight)
+    {
+        gResources.renderWidth = width;
+        gResources.renderHeight = height;
+        gResources.historyValid = false;
+    }
+    // same field of view with fewer pixels
+    float stepX = gCamera.stepX * gResX / width;
+    float stepY = gCamera.stepY * gResY / height;
+
+    // every frame is timed for the telemetry; the scale is only for
+    // dynamic resolution
+    float timedScale = gDynamicResolution ? scale : 0.f;
+    BeginFrameTiming(timedScale);
+
     gl.clear().ColorBuffer();
 
+    bool reproject = gReprojection && gResources.historyValid;
+    if(reproject)
+        ReprojectHistory(gl, width, height, stepX, stepY);
+
     gResources.p.use();
 
+    Uniform<float>(gResources.p, "screenWidth").set((float)width);
+    Uniform<float>(gResources.p, "screenHeight").set((float)height);
     Uniform<Vec3f>(gResources.p, "cameraPos").set(gCamera.pos);
     Uniform<Vec3f>(gResources.p, "cameraUp").set(gCamera.up);
     Uniform<Vec3f>(gResources.p, "cameraDir").set(gCamera.dir);
-    Uniform<float>(gResources.p, "stepX").set(gCamera.stepX);
-    Uniform<float>(gResources.p, "stepY").set(gCamera.stepY);
+    Uniform<float>(gResources.p, "stepX").set(stepX);
+    Uniform<float>(gResources.p, "stepY").set(stepY);
+    Uniform<int>(gResources.p, "hierarchical").set(gHierarchical && gResources.hasPyramid);
+    Uniform<int>(gResources.p, "pyramidLevels").set(gResources.pyramidLevels);
+    Uniform<float>(gResources.p, "relaxation").set(gRelaxed ? gRelaxation : 1.f);
+    Uniform<int>(gResources.p, "analyticNormals").set(gAnalyticNormals);
+    Uniform<int>(gResources.p, "bakedShading").set(gBakedShading && gResources.hasShadingVolume);
+    Uniform<int>(gResources.p, "useHeightMap").set(gHeightMap && gResources.hasHeightMap);
+    Uniform<Vec2f>(gResources.p, "heightTileSize").set(gResources.heightTileSize);
+    Uniform<float>(gResources.p, "heightTop").set(gResources.heightTop);
+    Uniform<int>(gResources.p, "stepHeatmap").set(gStepHeatmap);
+    Uniform<float>(gResources.p, "heatmapMax").set(gHeatmapMax);
 
     Texture1D::active(0);
     gResources.worldTex.bind();
@@ -197,16 +783,85 @@ void Render(Context& gl)
     Texture1D::active(1);
     gResources.hgTex.bind();
 
-    gResources.vertexBuffer.bind();
+    if(gSparseWorld)
+    {
+        Texture3D::active(3);
+        gResources.pageTex.bind();
+        Texture3D::active(4);
+        gResources.atlasTex.bind();
+    }
 
-    VertexAttribArray attribPosition(gResources.p, "position");
-    attribPosition.setupPointer<Vec4f>();
-    attribPosition.enable();
+    if(gResources.hasPyramid)
+    {
+        Texture3D::active(5);
+        gResources.pyramidTex.bind();
+    }
 
-    gResources.elementBuffer.bind();
-    gl.drawElements(PrimitiveType::Quads, 4, IndicesType::UnsignedInt, 0);
+    if(gResources.hasShadingVolume)
+    {
+        Texture3D::active(10);
+        gResources.shadingTex.bind();
+    }
 
-    attribPosition.disable();
+    if(gResources.hasHeightMap)
+    {
+        Texture2D::active(11);
+        gResources.heightTex.bind();
+    }
+
+    if(gResources.prepassScale != gPrepassScale)
+        InitPrepass();
+
+    bool prepass = gResources.prepassScale > 1;
+    Uniform<int>(gResources.p, "prepassScale").set(gResources.prepassScale);
+    if(prepass)
+    {
+        // one fragment per block; the texture must not be bound while it is
+        // rendered to
+        Texture2D::active(6);
+        Texture2D::unbind();
+
+        gResources.prepassFbo.bind();
+        gl.viewport(0, 0, (width + gResources.prepassScale - 1) / gResources.prepassScale,
+                          (height + gResources.prepassScale - 1) / gResources.prepassScale);
+        Uniform<int>(gResources.p, "conePass").set(true);
+        DrawScreenQuad(gl);
+
+        Framebuffer::unbind();
+        gResources.prepassTex.bind();
+    }
+
+    Uniform<int>(gResources.p, "conePass").set(false);
+    Uniform<int>(gResources.p, "usePrepass").set(prepass);
+    Uniform<int>(gResources.p, "useReprojection").set(reproject);
+    Uniform<float>(gResources.p, "reprojectionBackoff").set(gReprojectionBackoff);
+
+    if(gReprojection || gDynamicResolution || gStepHeatmap)
+    {
+        gResources.frameFbo.bind();
+        gl.viewport(0, 0, width, height);
+        DrawScreenQuad(gl);
+        gResources.frameFbo.blitToWindow(width, height, gResX, gResY);
+        gl.viewport(0, 0, gResX, gResY);
+
+        if(gStepHeatmap && gResources.stepStatsFrame++ % STEP_STATS_INTERVAL == 0)
+            PrintStepStatistics(width, height);
+
+        if(gReprojection)
+        {
+            gResources.historyValid = true;
+            gResources.prevCameraPos = gCamera.pos;
+            gResources.prevCameraUp = gCamera.up;
+            gResources.prevCameraDir = gCamera.dir;
+        }
+    }
+    else
+    {
+        gl.viewport(0, 0, gResX, gResY);
+        DrawScreenQuad(gl);
+    }
+
+    EndFrameTiming(gl, timedScale);
 }
 
 void Move()
@@ -250,6 +905,68 @@ void OnKeyDown(const SDL_KeyboardEvent& event)
     case SDLK_MINUS:
         gSpeed /= 2.f;
         break;
+    case SDLK_h:
+        gHierarchical = !gHierarchical;
+        if(gHierarchical && !gResources.hasPyramid)
+            UploadPyramid(WorldView());
+        std::cout << "Hierarchical marching " << (gHierarchical ? "on" : "off") << "\n";
+        break;
+    case SDLK_p:
+        gPrepassScale = gPrepassScale == 0 ? 4 : gPrepassScale == 4 ? 8 : 0;
+        if(gPrepassScale)
+            std::cout << "Cone prepass at 1/" << gPrepassScale << " resolution\n";
+        else
+            std::cout << "Cone prepass off\n";
+        break;
+    case SDLK_t:
+        gReprojection = !gReprojection;
+        gResources.historyValid = false;
+        std::cout << "Temporal reprojection " << (gReprojection ? "on" : "off") << "\n";
+        break;
+    case SDLK_n:
+        gAnalyticNormals = !gAnalyticNormals;
+        std::cout << "Normals from " << (gAnalyticNormals ? "the analytic gradient" : "central differences") << "\n";
+        break;
+    case SDLK_b:
+        if(!gResources.hasShadingVolume)
+        {
+            std::cout << "No shading volume, start with --shading=baked\n";
+            break;
+        }
+        gBakedShading = !gBakedShading;
+        std::cout << (gBakedShading ? "Baked" : "Procedural") << " shading\n";
+        break;
+    case SDLK_m:
+        if(!gResources.hasHeightMap)
+        {
+            std::cout << "No height map, start with --height-map\n";
+            break;
+        }
+        gHeightMap = !gHeightMap;
+        std::cout << "Height map skipping " << (gHeightMap ? "on" : "off") << "\n";
+        break;
+    case SDLK_f:
+        gDynamicResolution = !gDynamicResolution;
+        gResources.renderScale.reset();
+        for(float& pending : gResources.frameQueryScale)
+            pending = 0.f;
+        if(gDynamicResolution)
+            std::cout << "Dynamic resolution, frame time budget " << gFrameBudget << " ms\n";
+        else
+            std::cout << "Dynamic resolution off\n";
+        break;
+    case SDLK_i:
+        gStepHeatmap = !gStepHeatmap;
+        gResources.stepStatsFrame = 0;
+        std::cout << "Step heatmap " << (gStepHeatmap ? "on" : "off") << "\n";
+        break;
+    case SDLK_l:
+        gTelemetry.report(std::cout);
+        break;
+    case SDLK_r:
+        gRelaxed = !gRelaxed;
+        std::cout << "Over-relaxed marching " << (gRelaxed ? "on" : "off") << " (omega " << gRelaxation << ")\n";
+        break;
     default: 
         break;
     }
@@ -261,6 +978,8 @@ void OnKeyUp(const SDL_KeyboardEvent& event)
 
 void OnMouseMotion(const SDL_MouseMotionEvent& event)
 {
+    if(!gPlayPath.empty())
+        return;
     if(event.state & SDL_BUTTON(SDL_BUTTON_LEFT) || gFullscreen)
     {
         gCamera.rotateX((float)event.xrel);
@@ -315,29 +1034,190 @@ bool HandleEvents()
     return true;
 }
 
+bool ParseOption(const char* arg)
+{
+    if(gWorldParams.parseOption(arg))
+        return true;
+    else if(!strcmp(arg, "--benchmark-sampler"))
+        gBenchmarkSampler = true;
+    else if(!strncmp(arg, "--world-cache=", 14))
+        gWorldCache = arg + 14;
+    else if(!strcmp(arg, "--no-world-cache"))
+        gWorldCache.clear();
+    else if(!strcmp(arg, "--world-format=r32f"))
+        gWorldEncoding = FieldEncoding::Float32;
+    else if(!strcmp(arg, "--world-format=r16f"))
+        gWorldEncoding = FieldEncoding::Half16;
+    else if(!strcmp(arg, "--world-format=r16snorm"))
+        gWorldEncoding = FieldEncoding::Snorm16;
+    else if(!strcmp(arg, "--world-format=r8snorm"))
+        gWorldEncoding = FieldEncoding::NarrowBand8;
+    else if(!strncmp(arg, "--narrow-band=", 14))
+        gNarrowBand = (float)atof(arg + 14);
+    else if(!strcmp(arg, "--sparse-world"))
+        gSparseWorld = true;
+    else if(!strncmp(arg, "--sparse-band=", 14))
+        gSparseBand = (float)atof(arg + 14);
+    else if(!strcmp(arg, "--hierarchical"))
+        gHierarchical = true;
+    else if(!strncmp(arg, "--pyramid-levels=", 17))
+        gPyramidLevels = atoi(arg + 17);
+    else if(!strcmp(arg, "--prepass=4"))
+        gPrepassScale = 4;
+    else if(!strcmp(arg, "--prepass=8"))
+        gPrepassScale = 8;
+    else if(!strcmp(arg, "--prepass=off"))
+        gPrepassScale = 0;
+    else if(!strcmp(arg, "--reproject"))
+        gReprojection = true;
+    else if(!strncmp(arg, "--reproject-backoff=", 20))
+    {
+        float backoff = (float)atof(arg + 20);
+        if(!(backoff > 0.f && backoff <= 1.f))
+            return false;
+        gReprojectionBackoff = backoff;
+    }
+    else if(!strcmp(arg, "--normals=analytic"))
+        gAnalyticNormals = true;
+    else if(!strcmp(arg, "--normals=differences"))
+        gAnalyticNormals = false;
+    else if(!strcmp(arg, "--shading=baked"))
+        gBakedShading = true;
+    else if(!strcmp(arg, "--shading=procedural"))
+        gBakedShading = false;
+    else if(!strcmp(arg, "--height-map"))
+        gHeightMap = true;
+    else if(!strncmp(arg, "--height-tile=", 14))
+        gHeightTile = atoi(arg + 14);
+    else if(!strncmp(arg, "--frame-budget=", 15))
+    {
+        gFrameBudget = (float)atof(arg + 15);
+        gDynamicResolution = gFrameBudget > 0.f;
+    }
+    else if(!strncmp(arg, "--profile=", 10))
+        gProfile = arg + 10;
+    else if(!strncmp(arg, "--record-path=", 14))
+        gRecordPath = arg + 14;
+    else if(!strncmp(arg, "--play-path=", 12))
+        gPlayPath = arg + 12;
+    else if(!strncmp(arg, "--path-times=", 13))
+        gPathTimes = arg + 13;
+    else if(!strncmp(arg, "--frame-times=", 14))
+        gFrameTimesCsv = arg + 14;
+    else if(!strcmp(arg, "--step-heatmap"))
+        gStepHeatmap = true;
+    else if(!strncmp(arg, "--heatmap-max=", 14))
+        gHeatmapMax = std::max(1.f, (float)atof(arg + 14));
+    else if(!strncmp(arg, "--min-render-scale=", 19))
+        gMinRenderScale = std::min(1.f, std::max(0.05f, (float)atof(arg + 19)));
+    else if(!strncmp(arg, "--relaxation=", 13))
+    {
+        gRelaxation = std::max(1.f, (float)atof(arg + 13));
+        gRelaxed = gRelaxation > 1.f;
+    }
+    else
+        return false;
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     if(argc == 2 && (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h")))
     {
-        std::cout << "Usage: " << argv[0] << " <width> <height> <fullscreen> <vsync>\n";
+        std::cout << "Usage: " << argv[0] << " [options] <width> <height> <fullscreen> <vsync>\n"
+                  << "Options:\n"
+                  << WORLD_OPTIONS_HELP
+                  << "  --benchmark-sampler  Time CPU sampling of the world in linear and bricked layout,\n"
+                  << "                       and sparse with --sparse-world\n"
+                  << "  --world-cache=<file> Generated world is cached in file (default: data/world.cache)\n"
+                  << "  --no-world-cache     Always generate the world\n"
+                  << "  --world-format=r32f|r16f|r16snorm|r8snorm  Texture format of the world (default: r32f)\n"
+                  << "  --narrow-band=<n>    Distances are clamped to n voxels in r8snorm (default: 16)\n"
+                  << "  --sparse-world       Only store bricks near the surface (page table and atlas)\n"
+                  << "  --sparse-band=<n>    Bricks within n voxels of the surface are stored (default: 4)\n"
+                  << "  --hierarchical       Skip empty space with the min-distance pyramid (key H)\n"
+                  << "  --pyramid-levels=<n> Levels of the min-distance pyramid (default: 3)\n"
+                  << "  --relaxation=<omega> Over-relaxed sphere tracing with omega, e.g. 1.6 (key R)\n"
+                  << "  --prepass=4|8|off    Cone marching prepass at 1/4 or 1/8 resolution that finds\n"
+                  << "                       start distances for the full resolution rays (key P)\n"
+                  << "  --reproject          Start rays at the reprojected end points of the previous frame (key T)\n"
+                  << "  --reproject-backoff=<f>  Fraction (0, 1] of the reprojected distance to start at (default: 0.9)\n"
+                  << "  --normals=analytic|differences  Normals from the gradient of the B-spline or from\n"
+                  << "                       central differences (default: analytic, key N)\n"
+                  << "  --shading=baked|procedural  Shade hits from a baked RGBA8 normal and detail volume,\n"
+                  << "                       or compute normal and colour per hit (default: procedural, key B)\n"
+                  << "  --height-map         Skip the space above the terrain with a per-tile max height map (key M)\n"
+                  << "  --height-tile=<n>    Tile size of the height map in voxels (default: 4)\n"
+                  << "  --frame-budget=<ms>  Dynamic resolution: scale the render resolution to keep frames\n"
+                  << "                       at about ms milliseconds, e.g. 16.7 (key F toggles, default: off)\n"
+                  << "  --min-render-scale=<f>  Smallest fraction of the window resolution (default: 0.25)\n"
+                  << "  --profile=<file>     On exit, print the time spent per profiler zone and write a\n"
+                  << "                       Chrome trace (chrome://tracing, Perfetto) of the run to file\n"
+                  << "  --step-heatmap       Show the march loop iterations per pixel in false colour and print\n"
+                  << "                       their mean, p50, p99 and max every " << STEP_STATS_INTERVAL << " frames (key I)\n"
+                  << "  --heatmap-max=<n>    Iterations shown as red in the heatmap, more are white (default: 64)\n"
+                  << "  --record-path=<file> Record the camera pose of every frame and write it to file on exit\n"
+                  << "  --play-path=<file>   Replay a recorded camera path (see data/paths) a pose per frame,\n"
+                  << "                       print the frame times and quit; use vsync 0 for timing\n"
+                  << "  --path-times=<file>  Write the frame times of --play-path as CSV\n"
+                  << "  --frame-times=<file> On exit, write the frame, CPU, GPU and present time of the last\n"
+                  << "                       " << FRAME_TELEMETRY_FRAMES << " frames as CSV\n";
         return 0;
     }
 
-    if(argc >= 4)
+    std::vector<char*> args;
+    for(int i=0; i<argc; ++i)
+    {
+        if(strncmp(argv[i], "--", 2))
+            args.push_back(argv[i]);
+        else if(!ParseOption(argv[i]))
+        {
+            std::cout << "Unknown option " << argv[i] << ", see " << argv[0] << " --help\n";
+            return 1;
+        }
+    }
+
+    if(args.size() >= 4)
     {
-        gResX = atoi(argv[1]);
-        gResY = atoi(argv[2]);
-        gFullscreen = atoi(argv[3]);
-        if(argc >= 5)
+        gResX = atoi(args[1]);
+        gResY = atoi(args[2]);
+        gFullscreen = atoi(args[3]);
+        if(args.size() >= 5)
+        {
+            gVsync = atoi(args[4]);
+        }
+        if(gResX <= 0 || gResY <= 0)
         {
-            gVsync = atoi(argv[4]);
+            std::cout << "Invalid window size " << args[1] << "x" << args[2] << ", see " << argv[0] << " --help\n";
+            return 1;
         }
     }
 
+    if(!gPlayPath.empty())
+    {
+        std::string pathWorld;
+        if(!loadCameraPath(gPlayPath, gCameraPath, &pathWorld) || gCameraPath.empty())
+        {
+            std::cout << "Could not read camera path " << gPlayPath << "\n";
+            return 1;
+        }
+        checkCameraPathWorld(std::cout, gPlayPath, pathWorld, gWorldParams);
+    }
+
     std::cout << "Keys:\n";
     std::cout << "  WASD  Movement\n";
     std::cout << "  +     Increase speed\n";
     std::cout << "  -     Decrease speed\n";
+    std::cout << "  H     Toggle hierarchical marching\n";
+    std::cout << "  R     Toggle over-relaxed marching\n";
+    std::cout << "  P     Cycle cone prepass: 1/4, 1/8 resolution, off\n";
+    std::cout << "  T     Toggle temporal reprojection\n";
+    std::cout << "  N     Toggle analytic / central difference normals\n";
+    std::cout << "  B     Toggle baked / procedural shading (with --shading=baked)\n";
+    std::cout << "  M     Toggle height map skipping (with --height-map)\n";
+    std::cout << "  F     Toggle dynamic resolution\n";
+    std::cout << "  I     Toggle step heatmap and statistics\n";
+    std::cout << "  L     Print frame time percentiles\n";
     std::cout << "  Tab   Print position\n";
     std::cout << "  Esc   Quit\n";
     std::cout << std::endl;
@@ -350,20 +1230,80 @@ int main(int argc, char* argv[])
         if(gFullscreen)
             SDL_ShowCursor(0);
 
-        Init(gl);
+        {
+            ProfileZone zone("init");
+            Init(gl);
+        }
 
         WatchFile("data/shader/shader.vert", CreateSDLEventFunc<EVENT_RELOADSHADERCODE>);
         WatchFile("data/shader/shader.frag", CreateSDLEventFunc<EVENT_RELOADSHADERCODE>);
+        WatchFile("data/shader/reproject.vert", CreateSDLEventFunc<EVENT_RELOADSHADERCODE>);
+        WatchFile("data/shader/reproject.frag", CreateSDLEventFunc<EVENT_RELOADSHADERCODE>);
 
+        int pathStart = gTelemetry.frames();
+        size_t pathFrame = 0;
+        int titleFrame = 0;
+        int64_t titleTime = profilerNow();
         while(gRunning)
         {
-            if(!HandleEvents())
-                break;
+            ProfileZone frame("frame");
+            FrameSample sample;
+            {
+                ProfileZone zone("events");
+                if(!HandleEvents())
+                    break;
+            }
+
+            if(!gPlayPath.empty())
+            {
+                if(pathFrame == gCameraPath.size())
+                    break;
+                applyCameraPose(gCamera, gCameraPath[pathFrame++]);
+            }
+            else
+            {
+                Move();
+                if(!gRecordPath.empty())
+                    gCameraPath.push_back(cameraPose(gCamera));
+            }
+            {
+                ProfileZone zone("render");
+                Render(gl);
+            }
+            sample.cpuMs = frame.seconds() * 1000.;
+            {
+                ProfileZone zone("swap");
+                wnd.swap();
+                sample.presentMs = zone.end() * 1000.;
+            }
+            sample.frameMs = frame.end() * 1000.;
+            sample.gpuMs = -1.;
+            gTelemetry.add(sample);
 
-            Move();
-            Render(gl);
+            // median and worst frame since the last update; GPU times of
+            // the latest frames are still in flight
+            if((profilerNow() - titleTime) * 1e-9 >= TITLE_INTERVAL)
+            {
+                int frames = gTelemetry.frames() - titleFrame;
+                FrameTimeSummary total = gTelemetry.summary(&FrameSample::frameMs, frames);
+                FrameTimeSummary gpu = gTelemetry.summary(&FrameSample::gpuMs, frames);
+                char info[128];
+                if(gpu.count > 0)
+                    snprintf(info, sizeof(info), "%.1f ms p50, %.1f ms worst, GPU %.1f ms p50", total.p50, total.worst, gpu.p50);
+                else
+                    snprintf(info, sizeof(info), "%.1f ms p50, %.1f ms worst", total.p50, total.worst);
+                wnd.setTitleInfo(info);
+                titleFrame = gTelemetry.frames();
+                titleTime = profilerNow();
+            }
+        }
 
-            wnd.swap();
+        if(!gPlayPath.empty())
+        {
+            int frames = gTelemetry.frames() - pathStart;
+            printPlaybackSummary(std::cout, gTelemetry.summary(&FrameSample::frameMs, frames), pathStart);
+            if(!gPathTimes.empty() && !gTelemetry.writeCsv(gPathTimes, frames))
+                std::cout << "Could not write " << gPathTimes << "\n";
         }
     }
     catch(const std::exception& ex)
@@ -371,5 +1311,27 @@ int main(int argc, char* argv[])
         std::cout << ex.what() << "\n";
     }
 
+    if(gTelemetry.frames() > 0)
+    {
+        gTelemetry.report(std::cout);
+        if(!gFrameTimesCsv.empty() && !gTelemetry.writeCsv(gFrameTimesCsv))
+            std::cout << "Could not write " << gFrameTimesCsv << "\n";
+    }
+
+    if(!gRecordPath.empty())
+    {
+        if(saveCameraPath(gRecordPath, gCameraPath, cameraPathWorld(gWorldParams)))
+            std::cout << "Recorded " << gCameraPath.size() << " frames to " << gRecordPath << "\n";
+        else
+            std::cout << "Could not write " << gRecordPath << "\n";
+    }
+
+    if(!gProfile.empty())
+    {
+        profilerReport(std::cout);
+        if(!writeChromeTrace(gProfile))
+            std::cout << "Could not write " << gProfile << "\n";
+    }
+
     return 0;
 }
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "World.h"
+#include "Profiler.h"
+#include "Percentile.h"
+
+// Generates worlds of several sizes with several thread counts, a number of
+// times each, and writes the median and 95th percentile time of every stage
+// of buildWorld() as JSON, to compare generator changes against.
+
+static WorldParams gWorldParams;
+static std::vector<int> gSizes;
+static std::vector<int> gThreadCounts;
+static int gRepeats = 5;
+static std::string gOutput = "world_benchmark.json";
+
+static bool parseList(const char* s, std::vector<int>& list, int minValue = 1)
+{
+    list.clear();
+    std::istringstream in(s);
+    std::string item;
+    while(std::getline(in, item, ','))
+    {
+        int n = atoi(item.c_str());
+        if(n < minValue)
+            return false;
+        list.push_back(n);
+    }
+    return !list.empty();
+}
+
+bool ParseOption(const char* arg)
+{
+    if(!strncmp(arg, "--sizes=", 8))
+        return parseList(arg + 8, gSizes, MIN_WORLD_SIZE);
+    else if(!strncmp(arg, "--threads=", 10))
+        return parseList(arg + 10, gThreadCounts);
+    else if(!strncmp(arg, "--repeats=", 10))
+        gRepeats = std::max(1, atoi(arg + 10));
+    else if(!strncmp(arg, "--output=", 9))
+        gOutput = arg + 9;
+    else if(gWorldParams.parseOption(arg))
+        return true;
+    else
+        return false;
+    return true;
+}
+
+struct StageSamples
+{
+    std::string stage;
+    std::vector<double> seconds;
+};
+
+struct BenchmarkRun
+{
+    int size;
+    int threads;
+    std::vector<StageSamples> stages;   // the last one is the total
+};
+
+static const char* engineName(DistanceEngine engine)
+{
+    return engine == DistanceEngine::SeparableEDT ? "edt" : "vdt";
+}
+
+static const char* layoutName(VolumeLayout layout)
+{
+    return layout == VolumeLayout::Bricked ? "bricked" : "linear";
+}
+
+static void writeStage(std::ostream& out, const StageSamples& samples)
+{
+    std::vector<double> sorted = samples.seconds;
+    std::sort(sorted.begin(), sorted.end());
+    out << "{ \"stage\": \"" << samples.stage << "\""
+        << ", \"median_ms\": " << percentile(sorted, 50.) * 1000.
+        << ", \"p95_ms\": " << percentile(sorted, 95.) * 1000.
+        << ", \"min_ms\": " << sorted.front() * 1000.
+        << ", \"max_ms\": " << sorted.back() * 1000. << " }";
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchmarkRun>& runs)
+{
+    out << "{\n"
+        << "  \"generator\": \"" << WORLD_GENERATOR_VERSION << "\",\n"
+        << "  \"engine\": \"" << engineName(gWorldParams.engine) << "\",\n"
+        << "  \"layout\": \"" << layoutName(gWorldParams.layout) << "\",\n"
+        << "  \"repeats\": " << gRepeats << ",\n"
+        << "  \"runs\": [\n";
+    for(size_t i=0; i<runs.size(); ++i)
+    {
+        const BenchmarkRun& run = runs[i];
+        out << "    {\n"
+            << "      \"size\": " << run.size << ",\n"
+            << "      \"threads\": " << run.threads << ",\n"
+            << "      \"stages\": [\n";
+        for(size_t j=0; j<run.stages.size(); ++j)
+        {
+            out << "        ";
+            writeStage(out, run.stages[j]);
+            out << (j+1 < run.stages.size() ? ",\n" : "\n");
+        }
+        out << "      ]\n"
+            << "    }" << (i+1 < runs.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n"
+        << "}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i=1; i<argc; ++i)
+    {
+        if(!ParseOption(argv[i]))
+        {
+            if(strcmp(argv[i], "--help") && strcmp(argv[i], "-h"))
+                std::cout << "Unknown option " << argv[i] << "\n";
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << WORLD_OPTIONS_HELP
+                      << "  --sizes=<n,...>      World sizes to generate, instead of --world-size\n"
+                      << "                       (default: 64,128,256,512)\n"
+                      << "  --threads=<n,...>    Thread counts to generate with (default: 1, 2, 4, ... up to all cores)\n"
+                      << "  --repeats=<n>        Generations per size and thread count (default: 5)\n"
+                      << "  --output=<file>      JSON file with the stage timings (default: world_benchmark.json)\n";
+            return 1;
+        }
+    }
+
+    if(gSizes.empty())
+    {
+        for(int size=64; size<=512; size*=2)
+            gSizes.push_back(size);
+    }
+
+    if(gThreadCounts.empty())
+    {
+        int maxThreads = 1;
+#ifdef _OPENMP
+        maxThreads = omp_get_max_threads();
+#endif
+        for(int threads=1; threads<maxThreads; threads*=2)
+            gThreadCounts.push_back(threads);
+        gThreadCounts.push_back(maxThreads);
+    }
+
+    std::vector<BenchmarkRun> runs;
+    for(int size : gSizes)
+    {
+        for(int threads : gThreadCounts)
+        {
+#ifdef _OPENMP
+            omp_set_num_threads(threads);
+#else
+            if(threads > 1)
+                continue;
+#endif
+            WorldParams params = gWorldParams;
+            params.width = params.height = params.depth = size;
+
+            BenchmarkRun run;
+            run.size = size;
+            run.threads = threads;
+            for(int repeat=0; repeat<gRepeats; ++repeat)
+            {
+                std::cout << "World " << size << "^3, " << threads << " threads, run " << repeat+1 << " of " << gRepeats << "\n";
+
+                WorldStageTimes times;
+                ProfileZone zone("benchmark run");
+                buildWorld(params, &times);
+                times.add("total", zone.end());
+
+                // stages run in the same order every time
+                if(run.stages.empty())
+                {
+                    run.stages.resize(times.stages.size());
+                    for(size_t i=0; i<times.stages.size(); ++i)
+                        run.stages[i].stage = times.stages[i];
+                }
+                for(size_t i=0; i<times.stages.size(); ++i)
+                    run.stages[i].seconds.push_back(times.seconds[i]);
+            }
+            runs.push_back(run);
+        }
+    }
+
+    std::ofstream out(gOutput.c_str());
+    writeJson(out, runs);
+    if(!out)
+    {
+        std::cout << "Could not write " << gOutput << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << gOutput << "\n";
+    return 0;
+}
@@ -0,0 +1,382 @@
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Camera.h"
+#include "World.h"
+#include "DistanceFieldCache.h"
+#include "DistancePyramid.h"
+#include "CpuRenderer.h"
+#include "PacketTrace.h"
+#include "ShadingVolume.h"
+#include "Profiler.h"
+#include "StepStats.h"
+#include "CameraPath.h"
+#include "FrameTelemetry.h"
+
+// Renders one frame of the viewer on the CPU and writes it to an image,
+// for machines without GPU.
+
+static int gResX = 1024;
+static int gResY = 768;
+static WorldParams gWorldParams;
+static std::string gWorldCache = "data/world.cache";
+static std::string gOutput = "render.ppm";
+static RenderSettings gSettings;
+static int gPyramidLevels = 3;
+static int gThreads = 0;
+static TileSchedule gSchedule = TileSchedule::WorkStealing;
+static int gFrames = 1;
+static bool gThreadReport = false;
+static bool gCustomCamera = false;
+static Vec3f gCameraPos, gCameraUp, gCameraDir;
+static float gFovy = 45.f;
+static bool gReprojection = false;
+static float gFlySpeed = 0.f;
+static bool gBakedShading = false;
+static bool gHeightMap = false;
+static int gHeightTile = 4;
+static std::string gProfile;
+static bool gStepStats = false;
+static std::string gStepHeatmap;
+static std::string gStepCounts;
+static float gHeatmapMax = 64.f;
+static std::string gCameraPathFile;
+static std::string gPathTimes;
+
+static bool endsWith(const std::string& s, const char* suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() >= n && !s.compare(s.size() - n, n, suffix);
+}
+
+bool ParseOption(const char* arg)
+{
+    if(gWorldParams.parseOption(arg))
+        return true;
+    else if(!strncmp(arg, "--size=", 7))
+        return sscanf(arg + 7, "%dx%d", &gResX, &gResY) == 2 && gResX > 0 && gResY > 0;
+    else if(!strncmp(arg, "--output=", 9))
+        gOutput = arg + 9;
+    else if(!strncmp(arg, "--camera=", 9))
+    {
+        gCustomCamera = true;
+        return sscanf(arg + 9, "%f,%f,%f,%f,%f,%f,%f,%f,%f",
+                      &gCameraPos[0], &gCameraPos[1], &gCameraPos[2],
+                      &gCameraUp[0], &gCameraUp[1], &gCameraUp[2],
+                      &gCameraDir[0], &gCameraDir[1], &gCameraDir[2]) == 9;
+    }
+    else if(!strncmp(arg, "--fov=", 6))
+    {
+        gFovy = (float)atof(arg + 6);
+        return gFovy > 0.f && gFovy < 180.f;
+    }
+    else if(!strncmp(arg, "--tile=", 7))
+        gSettings.tileSize = atoi(arg + 7);
+    else if(!strncmp(arg, "--threads=", 10))
+        gThreads = atoi(arg + 10);
+    else if(!strcmp(arg, "--hierarchical"))
+        gSettings.hierarchical = true;
+    else if(!strcmp(arg, "--schedule=static"))
+        gSchedule = TileSchedule::Static;
+    else if(!strcmp(arg, "--schedule=steal"))
+        gSchedule = TileSchedule::WorkStealing;
+    else if(!strncmp(arg, "--frames=", 9))
+        gFrames = std::max(1, atoi(arg + 9));
+    else if(!strcmp(arg, "--thread-report"))
+        gThreadReport = true;
+    else if(!strcmp(arg, "--packets"))
+        gSettings.packets = true;
+    else if(!strcmp(arg, "--prepass=4"))
+        gSettings.prepassScale = 4;
+    else if(!strcmp(arg, "--prepass=8"))
+        gSettings.prepassScale = 8;
+    else if(!strcmp(arg, "--prepass=off"))
+        gSettings.prepassScale = 0;
+    else if(!strcmp(arg, "--reproject"))
+        gReprojection = true;
+    else if(!strncmp(arg, "--reproject-backoff=", 20))
+    {
+        float backoff = (float)atof(arg + 20);
+        if(!(backoff > 0.f && backoff <= 1.f))
+            return false;
+        gSettings.reprojectionBackoff = backoff;
+    }
+    else if(!strncmp(arg, "--camera-path=", 14))
+        gCameraPathFile = arg + 14;
+    else if(!strncmp(arg, "--path-times=", 13))
+        gPathTimes = arg + 13;
+    else if(!strncmp(arg, "--fly=", 6))
+        gFlySpeed = (float)atof(arg + 6);
+    else if(!strcmp(arg, "--normals=analytic"))
+        gSettings.analyticNormals = true;
+    else if(!strcmp(arg, "--normals=differences"))
+        gSettings.analyticNormals = false;
+    else if(!strcmp(arg, "--shading=baked"))
+        gBakedShading = true;
+    else if(!strcmp(arg, "--shading=procedural"))
+        gBakedShading = false;
+    else if(!strncmp(arg, "--relaxation=", 13))
+        gSettings.relaxation = std::max(1.f, (float)atof(arg + 13));
+    else if(!strcmp(arg, "--height-map"))
+        gHeightMap = true;
+    else if(!strncmp(arg, "--height-tile=", 14))
+        gHeightTile = atoi(arg + 14);
+    else if(!strncmp(arg, "--profile=", 10))
+        gProfile = arg + 10;
+    else if(!strcmp(arg, "--step-stats"))
+        gStepStats = true;
+    else if(!strncmp(arg, "--step-heatmap=", 15))
+    {
+        gStepHeatmap = arg + 15;
+        gStepStats = true;
+    }
+    else if(!strncmp(arg, "--step-counts=", 14))
+    {
+        gStepCounts = arg + 14;
+        gStepStats = true;
+    }
+    else if(!strncmp(arg, "--heatmap-max=", 14))
+        gHeatmapMax = std::max(1.f, (float)atof(arg + 14));
+    else if(!strncmp(arg, "--pyramid-levels=", 17))
+        gPyramidLevels = atoi(arg + 17);
+    else if(!strncmp(arg, "--world-cache=", 14))
+        gWorldCache = arg + 14;
+    else if(!strcmp(arg, "--no-world-cache"))
+        gWorldCache.clear();
+    else
+        return false;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i=1; i<argc; ++i)
+    {
+        if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h") || !ParseOption(argv[i]))
+        {
+            if(strcmp(argv[i], "--help") && strcmp(argv[i], "-h"))
+                std::cout << "Unknown option " << argv[i] << "\n";
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << WORLD_OPTIONS_HELP
+                      << "  --world-cache=<file> Generated world is cached in file (default: data/world.cache)\n"
+                      << "  --no-world-cache     Always generate the world\n"
+                      << "  --size=<w>x<h>       Image size (default: 1024x768)\n"
+                      << "  --output=<file>      .ppm or .pfm image (default: render.ppm)\n"
+                      << "  --camera=<px,py,pz,ux,uy,uz,dx,dy,dz>  Camera position, up and view direction\n"
+                      << "                       (default: start view of the viewer)\n"
+                      << "  --fov=<degrees>      Vertical field of view, below 180 (default: 45)\n"
+                      << "  --tile=<n>           Tile size in pixels (default: 16)\n"
+                      << "  --threads=<n>        Render threads (default: all cores)\n"
+                      << "  --schedule=static|steal  Tile distribution over threads: static ranges, or\n"
+                      << "                       work stealing ordered by last frame's tile cost (default)\n"
+                      << "  --frames=<n>         Render the frame n times, e.g. to let the scheduler adapt\n"
+                      << "  --thread-report      Print busy and idle time per thread for each frame\n"
+                      << "  --profile=<file>     Print the time spent per profiler zone and write a Chrome\n"
+                      << "                       trace (chrome://tracing, Perfetto) of the run to file\n"
+                      << "  --step-stats         Print mean, p50, p99 and max march loop iterations and\n"
+                      << "                       distance samples per pixel for each frame\n"
+                      << "  --step-heatmap=<file>  Write the iterations per pixel of the last frame as a\n"
+                      << "                       false colour .ppm, blue (none) to red (heatmap max)\n"
+                      << "  --step-counts=<file> Write iterations (red) and distance samples (green) per pixel\n"
+                      << "                       of the last frame as .pfm\n"
+                      << "  --heatmap-max=<n>    Iterations shown as red in the heatmap, more are white (default: 64)\n"
+                      << "  --hierarchical       Skip empty space with the min-distance pyramid\n"
+                      << "  --pyramid-levels=<n> Levels of the min-distance pyramid (default: 3)\n"
+                      << "  --height-map         Skip the space above the terrain with a per-tile max height map\n"
+                      << "  --height-tile=<n>    Tile size of the height map in voxels (default: 4)\n"
+                      << "  --packets            March primary rays in SIMD packets of " << PACKET_SIZE << "\n"
+                      << "  --relaxation=<omega> Over-relaxed sphere tracing, e.g. 1.6 (default: 1, off)\n"
+                      << "  --prepass=4|8|off    Cone marching prepass at 1/4 or 1/8 resolution that finds\n"
+                      << "                       start distances for the full resolution rays (default: off)\n"
+                      << "  --reproject          Start rays at the reprojected end points of the previous frame\n"
+                      << "  --reproject-backoff=<f>  Fraction (0, 1] of the reprojected distance to start at (default: 0.9)\n"
+                      << "  --fly=<d>            Move the camera forward by d between frames, like the viewer\n"
+                      << "  --camera-path=<file> Render a frame per pose of a recorded camera path (see\n"
+                      << "                       data/paths) instead of --frames, and print the frame times\n"
+                      << "  --path-times=<file>  Write the frame times of --camera-path as CSV\n"
+                      << "  --normals=analytic|differences  Normals from the gradient of the B-spline or from\n"
+                      << "                       central differences (default: analytic)\n"
+                      << "  --shading=baked|procedural  Shade hits from a baked RGBA8 normal and detail volume,\n"
+                      << "                       or compute normal and colour per hit (default: procedural)\n";
+            return 1;
+        }
+    }
+
+#ifdef _OPENMP
+    if(gThreads > 0)
+        omp_set_num_threads(gThreads);
+#endif
+
+    ProfileZone startup("startup");
+    DistanceField built(0, 0, 0);
+    MappedDistanceField cached;
+    DistanceFieldView world = built.view();
+    if(!gWorldCache.empty() && cached.open(gWorldCache, gWorldParams))
+    {
+        std::cout << "Loaded world from " << gWorldCache << "\n";
+        world = cached.view();
+    }
+    else
+    {
+        built = buildWorld(gWorldParams);
+        if(!gWorldCache.empty() && !saveDistanceField(gWorldCache, built, gWorldParams))
+            std::cout << "Could not write " << gWorldCache << "\n";
+        world = built.view();
+    }
+
+    DistancePyramid pyramid;
+    if(gSettings.hierarchical)
+    {
+        ProfileZone zone("distance pyramid");
+        pyramid = buildDistancePyramid(world, gPyramidLevels);
+    }
+
+    HeightMap heights;
+    if(gHeightMap)
+    {
+        ProfileZone zone("height map");
+        heights = buildHeightMap(world, gHeightTile);
+        if(heights.empty())
+            std::cout << "Height map tile size " << gHeightTile << " does not divide the world size\n";
+    }
+
+    ShadingVolume shading;
+    if(gBakedShading)
+    {
+        std::cout << "Baking shading volume..." << std::flush;
+        ProfileZone zone("bake shading volume");
+        shading = bakeShadingVolume(world);
+        zone.stop("  ");
+    }
+
+    CameraPath path;
+    if(!gCameraPathFile.empty())
+    {
+        std::string pathWorld;
+        if(!loadCameraPath(gCameraPathFile, path, &pathWorld) || path.empty())
+        {
+            std::cout << "Could not read camera path " << gCameraPathFile << "\n";
+            return 1;
+        }
+        checkCameraPathWorld(std::cout, gCameraPathFile, pathWorld, gWorldParams);
+        gFrames = (int)path.size();
+    }
+
+    Camera camera = defaultCamera(gResX, gResY);
+    if(gCustomCamera)
+        camera = Camera(gCameraPos, gCameraUp, gCameraDir, gFovy/180.f*3.14159265f, gResX, gResY);
+    else
+        camera = Camera(camera.pos, camera.up, camera.dir, gFovy/180.f*3.14159265f, gResX, gResY);
+
+    Image image(gResX, gResY);
+    TileScheduler scheduler(gSchedule);
+    startup.end();
+
+    double pixels = (double)gResX*gResY;
+
+    FrameHistory history;
+    StepBuffer steps;
+    FrameTelemetry telemetry(gFrames);
+    double firstFrameSteps = 0.;
+
+    for(int frame=0; frame<gFrames; ++frame)
+    {
+        ProfileZone frameZone("frame");
+        if(!path.empty())
+            applyCameraPose(camera, path[frame]);
+        else if(frame > 0)
+            camera.moveForward(gFlySpeed);
+
+        RenderStats stats = renderImage(world, &pyramid, gHeightMap ? &heights : NULL, gBakedShading ? &shading : NULL, camera, gSettings, image, scheduler, gReprojection ? &history : NULL, gStepStats ? &steps : NULL);
+
+        FrameSample sample = { 0, stats.seconds * 1000., -1., 0., stats.seconds * 1000. };
+        telemetry.add(sample);
+
+        std::cout << "Rendered " << gResX << "x" << gResY << " on " << scheduler.threadStats().size() << " threads in " << stats.seconds * 1000. << " ms, "
+                  << pixels / stats.seconds / 1e6 << " Mpixel/s, " << stats.steps / pixels << " steps";
+        if(gSettings.hierarchical)
+            std::cout << " + " << stats.coarseSteps / pixels << " pyramid lookups";
+        if(gHeightMap)
+            std::cout << " + " << stats.heightSkips / pixels << " height map skips";
+        if(gSettings.prepassScale > 1 || gReprojection)
+            std::cout << " + " << stats.prepassSteps / pixels << " prepass steps";
+        std::cout << " per pixel\n";
+        if(gSettings.prepassScale > 1 || gReprojection)
+            std::cout << "  prepass took " << stats.prepassSeconds * 1000. << " ms\n";
+        if(gReprojection)
+        {
+            if(frame == 0)
+                firstFrameSteps = (double)stats.steps;
+            std::cout << "  reprojected " << 100. * stats.reprojectedPixels / pixels << "% of the pixels, "
+                      << 100. * stats.disoccludedPixels / pixels << "% disoccluded, "
+                      << 100. * (1. - stats.steps / firstFrameSteps) << "% fewer steps than the first frame\n";
+        }
+
+        if(gStepStats)
+        {
+            StepStatistics iterations = stepStatistics(steps.iterations);
+            StepStatistics samples = stepStatistics(steps.samples);
+            std::cout << "  iterations per pixel: mean " << iterations.mean << ", p50 " << iterations.p50
+                      << ", p99 " << iterations.p99 << ", max " << iterations.max << "\n"
+                      << "  distance samples per pixel: mean " << samples.mean << ", p50 " << samples.p50
+                      << ", p99 " << samples.p99 << ", max " << samples.max << "\n";
+        }
+
+        if(gThreadReport)
+        {
+            const auto& threadStats = scheduler.threadStats();
+            for(size_t i=0; i<threadStats.size(); ++i)
+            {
+                std::cout << "  thread " << i << ": " << threadStats[i].tiles << " tiles (" << threadStats[i].stolen << " stolen), busy "
+                          << threadStats[i].busy * 1000. << " ms, idle " << threadStats[i].idle * 1000. << " ms\n";
+            }
+        }
+    }
+
+    if(!path.empty())
+    {
+        printPlaybackSummary(std::cout, telemetry.summary(&FrameSample::frameMs), 0);
+        if(!gPathTimes.empty() && !telemetry.writeCsv(gPathTimes))
+            std::cout << "Could not write " << gPathTimes << "\n";
+    }
+
+    if(!gProfile.empty())
+    {
+        profilerReport(std::cout);
+        if(!writeChromeTrace(gProfile))
+            std::cout << "Could not write " << gProfile << "\n";
+    }
+
+    if(!gStepHeatmap.empty())
+    {
+        Image heatmap(gResX, gResY);
+        for(size_t i=0; i<heatmap.pixels.size(); ++i)
+            heatmap.pixels[i] = heatmapColor((float)steps.iterations[i], gHeatmapMax);
+        if(!writePPM(gStepHeatmap, heatmap))
+            std::cout << "Could not write " << gStepHeatmap << "\n";
+    }
+
+    if(!gStepCounts.empty())
+    {
+        Image counts(gResX, gResY);
+        for(size_t i=0; i<counts.pixels.size(); ++i)
+            counts.pixels[i] = Vec3f((float)steps.iterations[i], (float)steps.samples[i], 0.f);
+        if(!writePFM(gStepCounts, counts))
+            std::cout << "Could not write " << gStepCounts << "\n";
+    }
+
+    bool written = endsWith(gOutput, ".pfm") ? writePFM(gOutput, image) : writePPM(gOutput, image);
+    if(!written)
+    {
+        std::cout << "Could not write " << gOutput << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "World.h"
+#include "DistanceFieldCache.h"
+#include "HeightMap.h"
+#include "CameraPath.h"
+
+// Generates the benchmark camera paths of data/paths for a world: a low
+// grazing flight, a high overview and a flight through the valleys. Heights
+// come from the per-tile max height map, so every pose is above the
+// terrain. Regenerate them whenever the world changes (size or
+// WORLD_GENERATOR_VERSION); playback warns about paths of other worlds.
+
+static WorldParams gWorldParams;
+static std::string gWorldCache = "data/world.cache";
+static std::string gOutput = "data/paths";
+static int gFrames = 300;
+
+static const float PI = 3.14159265f;
+
+bool ParseOption(const char* arg)
+{
+    if(gWorldParams.parseOption(arg))
+        return true;
+    else if(!strncmp(arg, "--world-cache=", 14))
+        gWorldCache = arg + 14;
+    else if(!strcmp(arg, "--no-world-cache"))
+        gWorldCache.clear();
+    else if(!strncmp(arg, "--output=", 9))
+        gOutput = arg + 9;
+    else if(!strncmp(arg, "--frames=", 9))
+    {
+        gFrames = atoi(arg + 9);
+        return gFrames > 0;
+    }
+    else
+        return false;
+    return true;
+}
+
+// Highest terrain bound within radius r of (x, z).
+static float terrainHeight(const HeightMap& heights, float x, float z, float r)
+{
+    float h = 0.f;
+    for(float dz=-r; dz<=r; dz+=heights.tileDepth*0.5f)
+    {
+        for(float dx=-r; dx<=r; dx+=heights.tileWidth*0.5f)
+            h = std::max(h, heights.height((int)floorf((x + dx) / heights.tileWidth), (int)floorf((z + dz) / heights.tileDepth)));
+    }
+    return h;
+}
+
+// Pose looking along dir, level: up is in the plane of dir and the y axis.
+static CameraPose levelPose(const Vec3f& pos, Vec3f dir)
+{
+    dir.normalize();
+    Vec3f right = dir.cross(Vec3f(0.f, 1.f, 0.f));
+    right.normalize();
+    Vec3f up = right.cross(dir);
+    up.normalize();
+    CameraPose pose = { pos, up, dir };
+    return pose;
+}
+
+// Straight flight from the start view of the viewer along its heading,
+// a little above the terrain ahead.
+static CameraPath grazingPath(const HeightMap& heights)
+{
+    Camera start = defaultCamera(1, 1);
+    float hx = start.dir[0], hz = start.dir[2];
+    float length = sqrtf(hx*hx + hz*hz);
+    hx /= length;
+    hz /= length;
+
+    CameraPath path;
+    float x = start.pos[0], z = 0.05f, y = 0.f;
+    for(int i=0; i<gFrames; ++i)
+    {
+        float target = terrainHeight(heights, x + hx*0.02f, z + hz*0.02f, 0.02f) + 0.012f;
+        y = i == 0 ? target : y + (target - y) * 0.15f;
+        y = std::max(y, terrainHeight(heights, x, z, 0.01f) + 0.006f);
+        path.push_back(levelPose(Vec3f(x, y, z), Vec3f(hx, -0.12f, hz)));
+        x += hx*0.003f;
+        z += hz*0.003f;
+    }
+    return path;
+}
+
+// Circle around the centre above the highest terrain, looking down.
+static CameraPath overviewPath(const HeightMap& heights)
+{
+    CameraPath path;
+    for(int i=0; i<gFrames; ++i)
+    {
+        float a = 2.f*PI*i/gFrames;
+        Vec3f pos(0.5f + 0.35f*cosf(a), heights.top + 0.25f, 0.5f + 0.35f*sinf(a));
+        Vec3f target(0.5f + 0.1f*cosf(a + 1.5f), 0.f, 0.5f + 0.1f*sinf(a + 1.5f));
+        path.push_back(levelPose(pos, target - pos));
+    }
+    return path;
+}
+
+// Starts at the lowest terrain of the centre and turns towards the lowest
+// terrain ahead, staying away from the edges of the world, so that it flies
+// along valleys below their walls.
+static CameraPath canyonPath(const HeightMap& heights)
+{
+    float x = 0.5f, z = 0.5f, lowest = INFINITY;
+    for(float sz=0.3f; sz<0.7f; sz+=0.01f)
+    {
+        for(float sx=0.3f; sx<0.7f; sx+=0.01f)
+        {
+            float h = terrainHeight(heights, sx, sz, 0.f);
+            if(h < lowest)
+            {
+                lowest = h;
+                x = sx;
+                z = sz;
+            }
+        }
+    }
+
+    float heading = 0.f;
+    lowest = INFINITY;
+    for(float a=0.f; a<2.f*PI; a+=0.05f)
+    {
+        float h = terrainHeight(heights, x + cosf(a)*0.05f, z + sinf(a)*0.05f, 0.f);
+        if(h < lowest)
+        {
+            lowest = h;
+            heading = a;
+        }
+    }
+
+    CameraPath path;
+    float y = 0.f;
+    for(int i=0; i<gFrames; ++i)
+    {
+        // lowest terrain ahead, preferring small turns
+        float best = heading, bestCost = INFINITY;
+        for(float a=-0.6f; a<=0.6f; a+=0.05f)
+        {
+            float cost = terrainHeight(heights, x + cosf(heading + a)*0.03f, z + sinf(heading + a)*0.03f, 0.004f) + fabsf(a)*0.01f;
+            float nx = x + cosf(heading + a)*0.06f, nz = z + sinf(heading + a)*0.06f;
+            if(nx < 0.05f || nx > 0.95f || nz < 0.05f || nz > 0.95f)
+                cost += 1.f;
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                best = heading + a;
+            }
+        }
+        heading += std::max(-0.04f, std::min(0.04f, best - heading));
+
+        float target = terrainHeight(heights, x, z, 0.006f) + 0.006f;
+        y = i == 0 ? target : std::max(target, y + (target - y) * 0.1f);
+        path.push_back(levelPose(Vec3f(x, y, z), Vec3f(cosf(heading), -0.05f, sinf(heading))));
+        x = std::min(0.98f, std::max(0.02f, x + cosf(heading)*0.002f));
+        z = std::min(0.98f, std::max(0.02f, z + sinf(heading)*0.002f));
+    }
+    return path;
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i=1; i<argc; ++i)
+    {
+        if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h") || !ParseOption(argv[i]))
+        {
+            if(strcmp(argv[i], "--help") && strcmp(argv[i], "-h"))
+                std::cout << "Unknown option " << argv[i] << "\n";
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << WORLD_OPTIONS_HELP
+                      << "  --world-cache=<file> Generated world is cached in file (default: data/world.cache)\n"
+                      << "  --no-world-cache     Always generate the world\n"
+                      << "  --output=<dir>       Directory of the path files (default: data/paths)\n"
+                      << "  --frames=<n>         Poses per path (default: 300)\n";
+            return 1;
+        }
+    }
+
+    DistanceField built(0, 0, 0);
+    MappedDistanceField cached;
+    DistanceFieldView world = built.view();
+    if(!gWorldCache.empty() && cached.open(gWorldCache, gWorldParams))
+    {
+        std::cout << "Loaded world from " << gWorldCache << "\n";
+        world = cached.view();
+    }
+    else
+    {
+        built = buildWorld(gWorldParams);
+        if(!gWorldCache.empty() && !saveDistanceField(gWorldCache, built, gWorldParams))
+            std::cout << "Could not write " << gWorldCache << "\n";
+        world = built.view();
+    }
+
+    // the viewer's default tile size where it divides the world, else
+    // single voxel columns
+    int tileSize = world.width % 4 == 0 && world.depth % 4 == 0 ? 4 : 1;
+    HeightMap heights = buildHeightMap(world, tileSize);
+
+    std::string pathWorld = cameraPathWorld(gWorldParams);
+    struct
+    {
+        const char* name;
+        const char* description;
+        CameraPath path;
+    } paths[] = {
+        { "grazing", "Low grazing flight a little above the terrain, from the start view along its heading", grazingPath(heights) },
+        { "overview", "High overview: circles the world above its highest terrain, looking down at the centre", overviewPath(heights) },
+        { "canyon", "In-canyon flight: follows the valleys below the surrounding walls", canyonPath(heights) },
+    };
+
+    for(const auto& p : paths)
+    {
+        std::string filename = gOutput + "/" + p.name + ".path";
+        if(!saveCameraPath(filename, p.path, pathWorld, std::string(p.description) + " (generated by RayMarchingPaths)"))
+        {
+            std::cout << "Could not write " << filename << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << p.path.size() << " poses to " << filename << "\n";
+    }
+    return 0;
+}